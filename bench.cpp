@@ -0,0 +1,530 @@
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <benchmark/benchmark.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "utility.h"
+#include "cube_def.h"
+#include "facelet.h"
+#include "coord_batch.h"
+#include "two_phase_solver.h"
+#include "solution_cache.h"
+#include "optimal_solver.h"
+
+using namespace Cube;
+
+static const std::string TablePath = "cube_solver_tables.bin";
+
+// Uniformly random cubes are drawn from a fixed seed, so that runs on different revisions measure the same work.
+static constexpr uint32_t CorpusSeed = 20190527;
+static constexpr int CorpusSize = 256;
+
+static const std::vector<CubeStatus> &corpus() {
+    static std::vector<CubeStatus> cubes = [] {
+        RandomFactory::Engine engine(CorpusSeed);
+        std::vector<CubeStatus> res;
+        for (int i = 0; i < CorpusSize; ++i) {
+            res.push_back(MoveFactory::genUniformCube(engine));
+        }
+        return res;
+    }();
+    return cubes;
+}
+
+// Exposes the table builders and counts search nodes.
+class BenchSolver : public TwoPhaseSolver {
+public:
+    using TwoPhaseSolver::buildTwistMoveTable;
+    using TwoPhaseSolver::buildFlipMoveTable;
+    using TwoPhaseSolver::buildConorPermMoveTable;
+    using TwoPhaseSolver::buildPhase2EdgePermMoveTable;
+    using TwoPhaseSolver::buildPhaseTwoEntryTables;
+    using TwoPhaseSolver::buildTwistConjTable;
+    using TwoPhaseSolver::buildFlipSliceTwistHeuristic;
+    using TwoPhaseSolver::buildConorPermSliceHeuristic;
+    using TwoPhaseSolver::buildEdgePermSliceHeuristic;
+
+    explicit BenchSolver(const std::string &tablePath) : TwoPhaseSolver(tablePath) {}
+
+    void buildFlipSliceSymTable(ThreadPool &) {
+        TwoPhaseSolver::buildFlipSliceSymTable();
+    }
+
+    // Copy the tables into private memory, so that they can be rebuilt one at a time.
+    void makeWritable() {
+        auto layout = tableLayout();
+        auto copy = TableStorage::allocate(layout);
+        for (uint32_t i = 0; i < layout.size(); ++i) {
+            std::memcpy(copy.section(i), tables_.section(i), layout[i]);
+        }
+        tables_ = std::move(copy);
+        bindTables();
+    }
+
+    // Nodes expanded by phaseOneSearch(start).
+    uint64_t phaseOneNodes(const CubeStatus &start) const {
+        SearchStats stats;
+        MoveName path[MaxPhaseOneDepth];
+        auto first = [](const MoveName *, int) { return true; };
+        phaseOneIda(start, MaxPhaseOneDepth, path, first, stats);
+        return stats.phaseOne_.totalNodes();
+    }
+
+    using TwoPhaseSolver::PhaseTwoEntry;
+    using TwoPhaseSolver::followPath;
+
+    // The first phase one solutions of start, in the order in which the search enters phase two.
+    std::vector<std::vector<MoveName>> phaseOneSolutions(const CubeStatus &start, size_t cnt) const {
+        std::vector<std::vector<MoveName>> res;
+        auto collect = [&res, cnt](const MoveName *path, int length) {
+            res.emplace_back(path, path + length);
+            return res.size() >= cnt;
+        };
+        NoSearchStats stats;
+        MoveName path[MaxPhaseOneDepth];
+        phaseOneIda(start, MaxPhaseOneDepth, path, collect, stats);
+        return res;
+    }
+
+    // Nodes expanded while enumerating the first cnt phase one solutions of start.
+    uint64_t enumeratePhaseOne(const CubeStatus &start, uint64_t cnt) const {
+        SearchStats stats;
+        uint64_t found = 0;
+        auto count = [&found, cnt](const MoveName *, int) { return ++found >= cnt; };
+        MoveName path[MaxPhaseOneDepth];
+        phaseOneIda(start, MaxPhaseOneDepth, path, count, stats);
+        return stats.phaseOne_.totalNodes();
+    }
+
+    // Nodes expanded by phaseTwoSearch(start).
+    uint64_t phaseTwoNodes(const CubeStatus &start) const {
+        SearchStats stats;
+        MoveName path[MaxPhaseTwoDepth];
+        phaseTwoIda(static_cast<uint16_t>(start.getConorPermCoord()),
+                    static_cast<uint16_t>(start.getPhase2EdgePermCoord()),
+                    static_cast<uint8_t>(start.getUDSliceSortedCoord() % SlicePermCnt), MaxPhaseTwoDepth, path, stats);
+        return stats.phaseTwo_.totalNodes();
+    }
+};
+
+static BenchSolver &sharedSolver() {
+    static BenchSolver solver(TablePath);
+    return solver;
+}
+
+// The tables copied out of the file into private memory, which gets huge pages where the file does not.
+static BenchSolver &privateSolver() {
+    static std::unique_ptr<BenchSolver> solver = [] {
+        auto res = std::make_unique<BenchSolver>(TablePath);
+        res->makeWritable();
+        return res;
+    }();
+    return *solver;
+}
+
+// A hardware event counted for this thread. Kernels which deny access to the counters, as in most virtual
+// machines, leave it unavailable, and the benchmarks leave out its counter.
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    PerfCounter(const PerfCounter &) = delete;
+
+    void operator=(const PerfCounter &) = delete;
+
+    ~PerfCounter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    uint64_t read() const {
+        uint64_t value = 0;
+        if (fd_ < 0 || ::read(fd_, &value, sizeof(value)) != sizeof(value)) {
+            return 0;
+        }
+        return value;
+    }
+
+    // Report the events since construction per item as counters[name].
+    void report(benchmark::State &state, const std::string &name, uint64_t items) const {
+        if (fd_ >= 0 && items > 0) {
+            state.counters[name] = static_cast<double>(read()) / static_cast<double>(items);
+        }
+    }
+
+private:
+    int fd_ = -1;
+};
+
+static PerfCounter cacheMisses() {
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+}
+
+static PerfCounter tlbMisses() {
+    return {PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16};
+}
+
+// Corpus cubes brought into G1 by their phase one solution.
+static const std::vector<CubeStatus> &phaseTwoCorpus() {
+    static std::vector<CubeStatus> cubes = [] {
+        auto &moveFactory = MoveFactory::getInstance();
+        std::vector<CubeStatus> res;
+        for (auto cube : corpus()) {
+            for (auto m : sharedSolver().phaseOneSearch(cube)) {
+                cube = moveFactory.getMoveByName(m) * cube;
+            }
+            res.push_back(cube);
+        }
+        return res;
+    }();
+    return cubes;
+}
+
+static void BM_Compose(benchmark::State &state) {
+    auto &moveFactory = MoveFactory::getInstance();
+    auto cube = corpus()[0];
+    int m = 0;
+    for (auto _ : state) {
+        cube *= moveFactory.getMoveByName(static_cast<MoveName>(m));
+        m = m == 17 ? 0 : m + 1;
+        benchmark::DoNotOptimize(cube);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Compose);
+
+static void BM_Coord(benchmark::State &state, uint64_t (CubeStatus::*getCoord)() const) {
+    const auto &cubes = corpus();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize((cubes[i].*getCoord)());
+        i = i + 1 == cubes.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_Coord, ConorOri, &CubeStatus::getConorOriCoord);
+BENCHMARK_CAPTURE(BM_Coord, EdgeOri, &CubeStatus::getEdgeOriCoord);
+BENCHMARK_CAPTURE(BM_Coord, ConorPerm, &CubeStatus::getConorPermCoord);
+BENCHMARK_CAPTURE(BM_Coord, EdgePerm, &CubeStatus::getEdgePermCoord);
+BENCHMARK_CAPTURE(BM_Coord, UDSlice, &CubeStatus::getUDSliceCoord);
+BENCHMARK_CAPTURE(BM_Coord, Phase2EdgePerm, &CubeStatus::getPhase2EdgePermCoord);
+BENCHMARK_CAPTURE(BM_Coord, UDSliceSorted, &CubeStatus::getUDSliceSortedCoord);
+
+// The same coordinates of the whole corpus at once, into one array.
+static void BM_CoordBatch(benchmark::State &state, void (*kernel)(std::span<const CubeStatus>, uint16_t *)) {
+    const auto &cubes = corpus();
+    std::vector<uint16_t> out(cubes.size());
+    for (auto _ : state) {
+        kernel(cubes, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * cubes.size()));
+}
+BENCHMARK_CAPTURE(BM_CoordBatch, ConorOri, &CoordBatch::conorOri);
+BENCHMARK_CAPTURE(BM_CoordBatch, EdgeOri, &CoordBatch::edgeOri);
+BENCHMARK_CAPTURE(BM_CoordBatch, ConorPerm, &CoordBatch::conorPerm);
+BENCHMARK_CAPTURE(BM_CoordBatch, UDSlice, &CoordBatch::udSlice);
+BENCHMARK_CAPTURE(BM_CoordBatch, Phase2EdgePerm, &CoordBatch::phase2EdgePerm);
+BENCHMARK_CAPTURE(BM_CoordBatch, UDSliceSorted, &CoordBatch::udSliceSorted);
+
+static void BM_GetByUDSliceCoord(benchmark::State &state) {
+    auto &moveFactory = MoveFactory::getInstance();
+    uint64_t coord = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(moveFactory.getByUDSliceCoord(coord));
+        coord = coord == 494 ? 0 : coord + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetByUDSliceCoord);
+
+static void BM_GenUniformCube(benchmark::State &state) {
+    RandomFactory::Engine engine(CorpusSeed);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MoveFactory::genUniformCube(engine));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenUniformCube);
+
+static void BM_ParseFacelets(benchmark::State &state) {
+    std::vector<std::string> strings;
+    for (const auto &cube : corpus()) {
+        strings.push_back(Facelets::toString(cube));
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Facelets::parse(strings[i]));
+        i = i + 1 == strings.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseFacelets);
+
+static void BM_SerializeFacelets(benchmark::State &state) {
+    const auto &cubes = corpus();
+    char out[Facelets::FaceletCnt];
+    size_t i = 0;
+    for (auto _ : state) {
+        Facelets::serialize(cubes[i], out);
+        benchmark::DoNotOptimize(out);
+        i = i + 1 == cubes.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SerializeFacelets);
+
+// Rebuild one table of a private copy of the tables, on all hardware threads.
+static void BM_BuildTable(benchmark::State &state, void (BenchSolver::*build)(ThreadPool &)) {
+    static auto scratch = [] {
+        auto solver = std::make_unique<BenchSolver>(TablePath);
+        solver->makeWritable();
+        return solver;
+    }();
+    ThreadPool pool;
+    for (auto _ : state) {
+        ((*scratch).*build)(pool);
+    }
+    state.counters["threads"] = pool.size();
+}
+BENCHMARK_CAPTURE(BM_BuildTable, TwistMove, &BenchSolver::buildTwistMoveTable)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, FlipMove, &BenchSolver::buildFlipMoveTable)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, ConorPermMove, &BenchSolver::buildConorPermMoveTable)
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, Phase2EdgePermMove, &BenchSolver::buildPhase2EdgePermMoveTable)
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, PhaseTwoEntry, &BenchSolver::buildPhaseTwoEntryTables)
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, FlipSliceSym, &BenchSolver::buildFlipSliceSymTable)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, TwistConj, &BenchSolver::buildTwistConjTable)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, FlipSliceTwistHeuristic, &BenchSolver::buildFlipSliceTwistHeuristic)
+        ->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK_CAPTURE(BM_BuildTable, ConorPermSliceHeuristic, &BenchSolver::buildConorPermSliceHeuristic)
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildTable, EdgePermSliceHeuristic, &BenchSolver::buildEdgePermSliceHeuristic)
+        ->Unit(benchmark::kMillisecond);
+
+static void BM_PhaseOneSearch(benchmark::State &state) {
+    auto &solver = sharedSolver();
+    const auto &cubes = corpus();
+    size_t i = 0;
+    uint64_t nodes = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(solver.phaseOneSearch(cubes[i]));
+        state.PauseTiming();
+        nodes += solver.phaseOneNodes(cubes[i]);
+        state.ResumeTiming();
+        i = i + 1 == cubes.size() ? 0 : i + 1;
+    }
+    state.counters["nodes/s"] = benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PhaseOneSearch)->Unit(benchmark::kMicrosecond);
+
+// The phase one search of a solve, which goes on through thousands of phase one solutions, without phase two,
+// on the mapped tables or on a private copy. Cache and TLB misses per node are reported where they can be
+// counted, to compare revisions and the two kinds of memory.
+static void BM_PhaseOneEnumerate(benchmark::State &state, bool privateTables) {
+    auto &solver = privateTables ? privateSolver() : sharedSolver();
+    const auto &cubes = corpus();
+    size_t i = 0;
+    uint64_t nodes = 0;
+    auto misses = cacheMisses();
+    auto tlb = tlbMisses();
+    for (auto _ : state) {
+        nodes += solver.enumeratePhaseOne(cubes[i], 5000);
+        i = i + 1 == cubes.size() ? 0 : i + 1;
+    }
+    misses.report(state, "cache_misses/node", nodes);
+    tlb.report(state, "dtlb_misses/node", nodes);
+    state.counters["nodes/s"] = benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_PhaseOneEnumerate, Mapped, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PhaseOneEnumerate, Private, true)->Unit(benchmark::kMillisecond);
+
+static void BM_PhaseTwoSearch(benchmark::State &state) {
+    auto &solver = sharedSolver();
+    const auto &cubes = phaseTwoCorpus();
+    size_t i = 0;
+    uint64_t nodes = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(solver.phaseTwoSearch(cubes[i]));
+        state.PauseTiming();
+        nodes += solver.phaseTwoNodes(cubes[i]);
+        state.ResumeTiming();
+        i = i + 1 == cubes.size() ? 0 : i + 1;
+    }
+    state.counters["nodes/s"] = benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PhaseTwoSearch)->Unit(benchmark::kMicrosecond);
+
+// Phase two coordinates at the end of the first phase one solutions of corpus cubes, taken in search order
+// either by replaying the path on the cube or by the tables along the path, see PhaseTwoEntry.
+static void BM_PhaseTwoEntry(benchmark::State &state, bool incremental) {
+    auto &solver = sharedSolver();
+    auto &moveFactory = MoveFactory::getInstance();
+    constexpr int CubeCnt = 64;
+    std::vector<std::vector<std::vector<MoveName>>> solutions;
+    for (int i = 0; i < CubeCnt; ++i) {
+        solutions.push_back(solver.phaseOneSolutions(corpus()[i], 100));
+    }
+    uint64_t entries = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < CubeCnt; ++i) {
+            const auto &start = corpus()[i];
+            BenchSolver::PhaseTwoEntry entry;
+            entry.reset(start);
+            for (const auto &path : solutions[i]) {
+                auto length = static_cast<int>(path.size());
+                if (incremental) {
+                    solver.followPath(entry, path.data(), length);
+                    benchmark::DoNotOptimize(entry.conorPerm_[length] + entry.uEdges_[length] +
+                                             entry.dEdges_[length] + entry.sliceSorted_[length]);
+                } else {
+                    auto cur = start;
+                    for (auto m : path) {
+                        cur = moveFactory.getMoveByName(m) * cur;
+                    }
+                    benchmark::DoNotOptimize(cur.getConorPermCoord() + cur.getPhase2EdgePermCoord() +
+                                             cur.getUDSliceSortedCoord());
+                }
+            }
+            entries += solutions[i].size();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(entries));
+}
+BENCHMARK_CAPTURE(BM_PhaseTwoEntry, Replay, false);
+BENCHMARK_CAPTURE(BM_PhaseTwoEntry, Incremental, true);
+
+// Hits on symmetric variants of cached cubes, which pay for canonicalization and conjugating back.
+static void BM_SolutionCacheHit(benchmark::State &state) {
+    auto &solver = sharedSolver();
+    const auto &cubes = corpus();
+    SolutionCache cache(cubes.size());
+    for (size_t i = 0; i < 16; ++i) {
+        cache.solve(solver, cubes[i]);
+    }
+    std::vector<MoveName> solution;
+    size_t i = 0;
+    int s = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.lookup(MoveFactory::conjugate(cubes[i], s), solution));
+        i = i + 1 == 16 ? 0 : i + 1;
+        s = s == 47 ? 0 : s + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SolutionCacheHit);
+
+// Optimal solves of cubes a fixed number of random moves from solved, reporting the search throughput.
+static void BM_OptimalSolve(benchmark::State &state) {
+    static OptimalSolver solver(sharedSolver(), TablePath + ".optimal");
+    RandomFactory::Engine engine(CorpusSeed);
+    std::uniform_int_distribution<int> move(0, 17);
+    std::vector<CubeStatus> cubes;
+    for (int i = 0; i < 8; ++i) {
+        auto cube = MoveFactory::Id_;
+        for (int64_t k = 0; k < state.range(0); ++k) {
+            cube = MoveFactory::Moves_[move(engine)] * cube;
+        }
+        cubes.push_back(cube);
+    }
+    PhaseStats stats;
+    for (auto _ : state) {
+        for (const auto &cube : cubes) {
+            stats += solver.solve(cube).stats_;
+        }
+    }
+    state.counters["nodes/s"] = stats.nodesPerSecond();
+    state.counters["cutoff_rate"] = stats.cutoffRate();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * cubes.size()));
+}
+BENCHMARK(BM_OptimalSolve)->Arg(12)->Arg(14)->Arg(16)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// Mean solution length within a fixed time per cube, of one search or of solveRacing on all cores.
+static void BM_SolveWithin(benchmark::State &state, bool racing) {
+    auto &solver = sharedSolver();
+    const auto &cubes = corpus();
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    TwoPhaseSolver::SolveBudget budget;
+    budget.seconds_ = 0.05;
+    uint64_t moves = 0, solved = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < 32; ++i) {
+            auto res = racing ? solver.solveRacing(cubes[i], pool, budget) : solver.solveAnytime(cubes[i], budget);
+            moves += res.solution_.size();
+            solved += 1;
+        }
+    }
+    state.counters["mean_length"] = static_cast<double>(moves) / static_cast<double>(solved);
+    state.SetItemsProcessed(static_cast<int64_t>(solved));
+}
+BENCHMARK_CAPTURE(BM_SolveWithin, Anytime, false)->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK_CAPTURE(BM_SolveWithin, Racing, true)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// One pass over the corpus, reporting the latency percentiles of single solves.
+static void BM_Solve(benchmark::State &state) {
+    auto &solver = sharedSolver();
+    const auto &cubes = corpus();
+    std::vector<double> latency;
+    auto misses = cacheMisses();
+    for (auto _ : state) {
+        for (const auto &cube : cubes) {
+            auto begin = std::chrono::steady_clock::now();
+            benchmark::DoNotOptimize(solver.solve(cube));
+            auto end = std::chrono::steady_clock::now();
+            latency.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    state.counters["p50_ms"] = latency[latency.size() / 2];
+    state.counters["p99_ms"] = latency[latency.size() * 99 / 100];
+    misses.report(state, "cache_misses/solve", latency.size());
+    state.SetItemsProcessed(static_cast<int64_t>(latency.size()));
+}
+BENCHMARK(BM_Solve)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// Throughput of solveBatch over the corpus on all cores, with the tables placed by each NUMA policy and the
+// workers pinned to the nodes. On a multi-socket host, Replicate should come close to nodes times the
+// throughput of one socket.
+static void BM_SolveBatch(benchmark::State &state, TwoPhaseSolver::NumaPolicy policy) {
+    TwoPhaseSolver solver(TablePath);
+    solver.placeTables(policy);
+    const auto &cubes = corpus();
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1,
+                    policy != TwoPhaseSolver::NumaPolicy::Shared);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(solver.solveBatch(cubes, pool));
+    }
+    state.counters["cubes/s/node"] = benchmark::Counter(
+            static_cast<double>(state.iterations() * cubes.size()) / NumaTopology::get().nodeCnt(),
+            benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * cubes.size()));
+}
+BENCHMARK_CAPTURE(BM_SolveBatch, Shared, TwoPhaseSolver::NumaPolicy::Shared)
+        ->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(1);
+BENCHMARK_CAPTURE(BM_SolveBatch, Interleave, TwoPhaseSolver::NumaPolicy::Interleave)
+        ->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(1);
+BENCHMARK_CAPTURE(BM_SolveBatch, Replicate, TwoPhaseSolver::NumaPolicy::Replicate)
+        ->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(1);
+
+BENCHMARK_MAIN();
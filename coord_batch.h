@@ -0,0 +1,174 @@
+#ifndef CUBE_SOLVER_COORD_BATCH_H
+#define CUBE_SOLVER_COORD_BATCH_H
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "cube_def.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Coordinates of many cubes at once, each kernel writing one coordinate of cubes[i] to out[i].
+     *
+     * With AVX2 the twist of four cubes and the flip of two are computed in one register. The other
+     * coordinates go through CubeStatus, which ranks permutations by popcount in linear time.
+     * */
+    class CoordBatch {
+    public:
+        CoordBatch() = delete;
+
+        static void conorOri(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void edgeOri(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void conorPerm(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void edgePerm(std::span<const CubeStatus> cubes, uint32_t *out);
+
+        static void udSlice(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void phase2EdgePerm(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void udSliceSorted(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void uEdges(std::span<const CubeStatus> cubes, uint16_t *out);
+
+        static void dEdges(std::span<const CubeStatus> cubes, uint16_t *out);
+    };
+
+    // The coordinates of the two phases of many cubes, one array per coordinate.
+    struct CubeCoords {
+        std::vector<uint16_t> twist_, flip_, slice_;
+        std::vector<uint16_t> conorPerm_, phase2EdgePerm_, sliceSorted_;
+
+        // Replace the contents by the coordinates of cubes.
+        void assign(std::span<const CubeStatus> cubes);
+
+        size_t size() const;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    void CoordBatch::conorOri(std::span<const CubeStatus> cubes, uint16_t *out) {
+        size_t i = 0;
+#ifdef __AVX2__
+        // Conor blocks are the first 8 bytes of a cube, one cube per 64-bit lane. Pairs of orientations
+        // o0 * 3 + o1 are formed first, then weighted by 243, 27, 3 and 1.
+        const __m256i pairWeight = _mm256_set1_epi64x(0x0001010301030103LL);
+        const __m256i quadWeight = _mm256_set1_epi64x(0x00010003001b00f3LL);
+        for (; i + 4 <= cubes.size(); i += 4) {
+            uint64_t word[4];
+            for (int k = 0; k < 4; ++k) {
+                std::memcpy(&word[k], cubes[i + k].move_, sizeof(uint64_t));
+            }
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(word));
+            __m256i ori = _mm256_and_si256(_mm256_srli_epi16(v, 5), _mm256_set1_epi8(7));
+            __m256i pairs = _mm256_maddubs_epi16(ori, pairWeight);
+            __m256i halves = _mm256_madd_epi16(pairs, quadWeight);
+            __m256i sum = _mm256_add_epi32(halves, _mm256_srli_epi64(halves, 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(word), sum);
+            for (int k = 0; k < 4; ++k) {
+                out[i + k] = static_cast<uint16_t>(word[k]);
+            }
+        }
+#endif
+        for (; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getConorOriCoord());
+        }
+    }
+
+    void CoordBatch::edgeOri(std::span<const CubeStatus> cubes, uint16_t *out) {
+        size_t i = 0;
+#ifdef __AVX2__
+        // Edges UR..BL, all but BR whose orientation follows from the others, are bytes 8..18. Reversing them
+        // puts the first edge at the top of the 11-bit coordinate, and shifting moves the orientation bit
+        // into the sign bit read by movemask.
+        const __m256i reverse = _mm256_setr_epi8(10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, -1, -1, -1, -1, -1,
+                                                 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, -1, -1, -1, -1, -1);
+        for (; i + 2 <= cubes.size(); i += 2) {
+            __m256i v = _mm256_loadu2_m128i(reinterpret_cast<const __m128i *>(cubes[i + 1].move_ + BlockPos::UR),
+                                            reinterpret_cast<const __m128i *>(cubes[i].move_ + BlockPos::UR));
+            auto mask = static_cast<uint32_t>(
+                    _mm256_movemask_epi8(_mm256_slli_epi16(_mm256_shuffle_epi8(v, reverse), 2)));
+            out[i] = static_cast<uint16_t>(mask & 0x7ff);
+            out[i + 1] = static_cast<uint16_t>(mask >> 16 & 0x7ff);
+        }
+#endif
+        for (; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getEdgeOriCoord());
+        }
+    }
+
+    void CoordBatch::conorPerm(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getConorPermCoord());
+        }
+    }
+
+    void CoordBatch::edgePerm(std::span<const CubeStatus> cubes, uint32_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint32_t>(cubes[i].getEdgePermCoord());
+        }
+    }
+
+    void CoordBatch::udSlice(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getUDSliceCoord());
+        }
+    }
+
+    void CoordBatch::phase2EdgePerm(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getPhase2EdgePermCoord());
+        }
+    }
+
+    void CoordBatch::udSliceSorted(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getUDSliceSortedCoord());
+        }
+    }
+
+    void CoordBatch::uEdges(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getUEdgesCoord());
+        }
+    }
+
+    void CoordBatch::dEdges(std::span<const CubeStatus> cubes, uint16_t *out) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            out[i] = static_cast<uint16_t>(cubes[i].getDEdgesCoord());
+        }
+    }
+
+    void CubeCoords::assign(std::span<const CubeStatus> cubes) {
+        for (auto *coords : {&twist_, &flip_, &slice_, &conorPerm_, &phase2EdgePerm_, &sliceSorted_}) {
+            coords->resize(cubes.size());
+        }
+        CoordBatch::conorOri(cubes, twist_.data());
+        CoordBatch::edgeOri(cubes, flip_.data());
+        CoordBatch::udSlice(cubes, slice_.data());
+        CoordBatch::conorPerm(cubes, conorPerm_.data());
+        CoordBatch::phase2EdgePerm(cubes, phase2EdgePerm_.data());
+        CoordBatch::udSliceSorted(cubes, sliceSorted_.data());
+    }
+
+    size_t CubeCoords::size() const {
+        return twist_.size();
+    }
+}
+
+#endif //CUBE_SOLVER_COORD_BATCH_H
@@ -7,6 +7,14 @@
 #include <algorithm>
 #include <random>
 #include <iostream>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <bit>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "utility.h"
 
@@ -16,20 +24,31 @@ namespace Cube {
     // Declarations
     //**********************************************************************
 
+    // One block packed into a byte, the position in the low 5 bits and the orientation in the high 3 bits.
     class MoveResult {
     public:
-        BlockPos pos_;
-        int8_t ori_;
+        static constexpr uint8_t PosMask = 0x1f;
+        static constexpr int OriShift = 5;
+
+        uint8_t packed_ = 0;
 
         MoveResult() = default;
 
-        MoveResult(BlockPos pos, int8_t ori);
+        constexpr MoveResult(BlockPos pos, int8_t ori);
+
+        constexpr MoveResult(int pos, int8_t ori);
+
+        constexpr BlockPos pos() const;
+
+        constexpr int8_t ori() const;
+
+        constexpr void setPos(BlockPos pos);
 
-        MoveResult(int pos, int8_t ori);
+        constexpr void setOri(int8_t ori);
 
-        bool operator==(const MoveResult &r) const;
+        constexpr bool operator==(const MoveResult &r) const;
 
-        bool operator!=(const MoveResult &r) const;
+        constexpr bool operator!=(const MoveResult &r) const;
     };
 
 
@@ -37,43 +56,85 @@ namespace Cube {
     public:
         CubeStatus() = default;
 
-        MoveResult move_[20];
+        // Blocks URF..BR. The rest is zero padding, so that a cube fills one 256-bit register.
+        alignas(32) MoveResult move_[32];
 
         // Position is replaced-by. Orientation is in-place.
         MoveResult operator()(BlockPos pos);
 
-        uint64_t getConorOriCoord();
+        constexpr uint64_t getConorOriCoord() const;
 
-        uint64_t getEdgeOriCoord();
+        constexpr uint64_t getEdgeOriCoord() const;
 
-        uint64_t getConorPermCoord();
+        constexpr uint64_t getConorPermCoord() const;
 
-        uint64_t getEdgePermCoord();
+        constexpr uint64_t getEdgePermCoord() const;
 
-        uint64_t getUDSliceCoord();
+        constexpr uint64_t getUDSliceCoord() const;
 
         /*
          * In phase 2, we only use the subgroup <U_, D_, L_^2, R_^2, F_^2, B_^2>
          * */
 
-        uint64_t getPhase2EdgePermCoord();
+        constexpr uint64_t getPhase2EdgePermCoord() const;
+
+        constexpr uint64_t getUDSliceSortedCoord() const;
+
+        // Positions and order of the edges UR..UB, and of DR..DB, see layerEdgesCoord. Both are below 1680
+        // in G1, where these edges stay in the U and D layers.
+        constexpr uint64_t getUEdgesCoord() const;
+
+        constexpr uint64_t getDEdgesCoord() const;
+
+        // Composition Operators. All of them run at compile time as well, where the scalar code is used.
+        constexpr CubeStatus &operator*=(const CubeStatus &other);
+
+        constexpr CubeStatus operator*(const CubeStatus &other) const;
+
+        constexpr CubeStatus inverse() const;
+
+        constexpr bool operator==(const CubeStatus &c) const;
 
-        uint64_t getUDSliceSortedCoord();
+        constexpr bool operator!=(const CubeStatus &c) const;
 
+        // UDSliceRank_[mask] is the UD-slice coordinate of the cubes whose slice edges are at the edge
+        // positions of the bits of mask, for masks of 4 bits.
+        static const std::array<uint16_t, 1 << 12> UDSliceRank_;
 
-        // Composition Operators
-        CubeStatus &operator*=(const CubeStatus &other);
+    protected:
+        // Rank of the permutation of the n blocks from first on, at positions base.. base + n - 1: block i
+        // contributes the number of blocks before it at a higher position, with weight i!.
+        constexpr uint64_t permRank(int first, int n, int base) const;
+
+        // Bit i is set if a UD-slice edge is at edge position i.
+        constexpr uint32_t udSliceMask() const;
 
-        CubeStatus operator*(const CubeStatus &other) const;
+        // The four edges from first on at edge positions p0 < p1 < p2 < p3 give the combination
+        // C(p0, 1) + C(p1, 2) + C(p2, 3) + C(p3, 4), which ranks those within UR..DB first, times 24 plus the
+        // rank of their order as in getUDSliceSortedCoord.
+        constexpr uint64_t layerEdgesCoord(int first) const;
 
-        CubeStatus inverse() const;
+        static constexpr std::array<uint16_t, 1 << 12> makeUDSliceRank();
 
-        bool operator==(const CubeStatus &c) const;
+        // Conor orientation composition when at least one side is mirrored (orientation 3..5).
+        static constexpr int8_t mirroredConorOri(int8_t thisOri, int8_t otherOri);
 
-        bool operator!=(const CubeStatus &c) const;
+        // operator*= one block at a time.
+        constexpr void composeScalar(const CubeStatus &other);
+
+#ifdef __AVX2__
+        // operator*= on all blocks at once, with the orientations added by table lookups.
+        inline void composeAvx2(const CubeStatus &other);
+#endif
     };
 
+    static_assert(sizeof(CubeStatus) == 32, "a cube must fit in 32 bytes");
 
+
+    /*
+     * Moves, symmetries, and cubes given by their coordinates. The constant cubes are computed at compile
+     * time, see their definitions at the end of this file.
+     * */
     class MoveFactory {
     public:
         // Prevent instantiation
@@ -83,64 +144,147 @@ namespace Cube {
 
         static MoveFactory &getInstance();
 
-        inline CubeStatus &getMoveByEnum(BasicMoveName m);
+        static constexpr const CubeStatus &getMoveByEnum(BasicMoveName m);
+
+        static constexpr const CubeStatus &getMoveByName(MoveName m);
 
+        // Cube reached by randomStep random face turns, each one allowed by NextMoves_ after the last.
         inline CubeStatus genRandomCube(uint64_t randomStep = 50);
 
-        inline CubeStatus getByUDSliceCoord(uint64_t coord);
+        // Uniformly distributed cube among all solvable ones, drawn as random coordinates with the parity
+        // of the edge permutation fixed up to match the corners.
+        static inline CubeStatus genUniformCube(RandomFactory::Engine &engine);
+
+        static inline CubeStatus genUniformCube();
+
+        static constexpr CubeStatus getByUDSliceCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByConorOriCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByEdgeOriCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByConorPermCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByPhase2EdgePermCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByUDSliceSortedCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByUEdgesCoord(uint64_t coord);
+
+        static constexpr CubeStatus getByDEdgesCoord(uint64_t coord);
 
         // Identity move_
-        CubeStatus Id_;
+        static const CubeStatus Id_;
 
         // Basic move_s
-        CubeStatus L_, R_, U_, D_, F_, B_;
-        //        CubeStatus Li, Ri, Ui, Di, Fi, Bi;
+        static const CubeStatus L_, R_, U_, D_, F_, B_;
+
+        // All face turns, indexed by MoveName
+        static const std::array<CubeStatus, 18> Moves_;
+
+        static const std::array<CubeStatus, 48> Sym_;
+
+        // Sym_[SymInv_[s]] is the inverse of Sym_[s]
+        static const std::array<int, 48> SymInv_;
+
+        // Sym_[s]^-1 * c * Sym_[s], i.e. c seen from the orientation given by symmetry s.
+        static constexpr CubeStatus conjugate(const CubeStatus &c, int s);
+
+        // The face turn Sym_[s] * m * Sym_[s]^-1, which does to conjugate(c, s) what m does to c.
+        static constexpr MoveName conjugateMove(MoveName m, int s);
+
+        // Index of NextMoves_ before the first move.
+        static constexpr int NoMove = 18;
 
-        CubeStatus Sym_[48];
+        // Bit m of NextMoves_[last] is set if move m may follow move last without a redundant sequence: no
+        // second turn of the same face, and of two opposite faces, which commute, only U before D, F before
+        // B and L before R.
+        static const std::array<uint32_t, NoMove + 1> NextMoves_;
+
+        // Merge consecutive turns of a face, also across a turn of the opposite face, and drop those which
+        // cancel. Returns the new length of moves, which is simplified in place.
+        static inline int simplifyMoves(MoveName *moves, int length);
     private:
         // Private constructors
-        MoveFactory();
+        MoveFactory() = default;
 
     protected:
         // Basic symmetric move_s
-        CubeStatus S_URF3, S_F2, S_U4, S_LR2;
+        static const CubeStatus S_URF3, S_F2, S_U4, S_LR2;
+
+        static constexpr void setAsId(CubeStatus &m);
+
+        static constexpr void setAsL(CubeStatus &m);
+
+        static constexpr void setAsR(CubeStatus &m);
+
+        static constexpr void setAsU(CubeStatus &m);
+
+        static constexpr void setAsD(CubeStatus &m);
+
+        static constexpr void setAsF(CubeStatus &m);
 
-        static inline void setAsId(CubeStatus &m);
+        static constexpr void setAsB(CubeStatus &m);
 
-        static inline void setAsL(CubeStatus &m);
+        static constexpr void setAsS_URF3(CubeStatus &m);
 
-        static inline void setAsR(CubeStatus &m);
+        static constexpr void setAsS_F2(CubeStatus &m);
 
-        static inline void setAsU(CubeStatus &m);
+        static constexpr void setAsS_U4(CubeStatus &m);
 
-        static inline void setAsD(CubeStatus &m);
+        static constexpr void setAsS_LR2(CubeStatus &m);
 
-        static inline void setAsF(CubeStatus &m);
+        // Decode a permutation coordinate of n blocks first, first + 1, ... into out[0..n).
+        static constexpr void decodePerm(uint64_t coord, int n, BlockPos first, BlockPos *out);
 
-        static inline void setAsB(CubeStatus &m);
+        // Parity of the permutation of n blocks with the given coordinate, 1 for odd.
+        static constexpr int permParity(uint64_t coord, int n);
 
-        static inline void setAsS_URF3(CubeStatus &m);
+        // A cube with the given CubeStatus::layerEdgesCoord, and the other edges anywhere.
+        static constexpr CubeStatus getByLayerEdgesCoord(uint64_t coord, int first);
 
-        static inline void setAsS_F2(CubeStatus &m);
+        // Builders of the constant cubes.
+        static constexpr CubeStatus makeCube(void (*setAs)(CubeStatus &));
 
-        static inline void setAsS_U4(CubeStatus &m);
+        static constexpr std::array<CubeStatus, 18> makeMoves();
 
-        static inline void setAsS_LR2(CubeStatus &m);
+        static constexpr std::array<CubeStatus, 48> makeSyms();
+
+        static constexpr std::array<int, 48> makeSymInv();
+
+        static constexpr std::array<uint32_t, NoMove + 1> makeNextMoves();
     };
 
     //**********************************************************************
     // Implementations
     //**********************************************************************
 
-    MoveResult::MoveResult(BlockPos pos, int8_t ori) : pos_(pos), ori_(ori) {}
+    constexpr MoveResult::MoveResult(BlockPos pos, int8_t ori)
+            : packed_(static_cast<uint8_t>(pos | ori << OriShift)) {}
 
-    MoveResult::MoveResult(int pos, int8_t ori) : pos_(static_cast<BlockPos>(pos)), ori_(ori) {}
+    constexpr MoveResult::MoveResult(int pos, int8_t ori) : MoveResult(static_cast<BlockPos>(pos), ori) {}
+
+    constexpr BlockPos MoveResult::pos() const {
+        return static_cast<BlockPos>(packed_ & PosMask);
+    }
 
-    bool MoveResult::operator==(const MoveResult &r) const {
-        return this->pos_ == r.pos_ && this->ori_ == r.ori_;
+    constexpr int8_t MoveResult::ori() const {
+        return static_cast<int8_t>(packed_ >> OriShift);
     }
 
-    bool MoveResult::operator!=(const MoveResult &r) const {
+    constexpr void MoveResult::setPos(BlockPos pos) {
+        packed_ = static_cast<uint8_t>((packed_ & ~PosMask) | pos);
+    }
+
+    constexpr void MoveResult::setOri(int8_t ori) {
+        packed_ = static_cast<uint8_t>((packed_ & PosMask) | ori << OriShift);
+    }
+
+    constexpr bool MoveResult::operator==(const MoveResult &r) const {
+        return this->packed_ == r.packed_;
+    }
+
+    constexpr bool MoveResult::operator!=(const MoveResult &r) const {
         return !this->operator==(r);
     }
 
@@ -149,164 +293,256 @@ namespace Cube {
         return move_[pos];
     }
 
-    uint64_t CubeStatus::getConorOriCoord() {
+    constexpr uint64_t CubeStatus::getConorOriCoord() const {
         int co = 0;
         // Summation of conor orientations is divided by 3.
         for (int i = BlockPos::URF; i < BlockPos::DRB; ++i) {
-            co = 3 * co + move_[i].ori_;
+            co = 3 * co + move_[i].ori();
         }
         return co;
     }
 
-    uint64_t CubeStatus::getEdgeOriCoord() {
+    constexpr uint64_t CubeStatus::getEdgeOriCoord() const {
         int co = 0;
         // Summation of edge orientations is divided by 2.
         for (int i = BlockPos::UR; i < BlockPos::BR; ++i) {
-            co = 2 * co + move_[i].ori_;
+            co = 2 * co + move_[i].ori();
         }
         return co;
     }
 
-    uint64_t CubeStatus::getConorPermCoord() {
-        int co = 0;
-        for (int i = BlockPos::DRB; i > BlockPos::URF; --i) {
-            int s = 0;
-            for (int j = i - 1; j >= BlockPos::URF; --j) {
-                if (move_[j].pos_ > move_[i].pos_) {
-                    s += 1;
-                }
-            }
-            // (i + 1) is the order of this conor.
-            co = (co + s) * (i + 1);
+    constexpr uint64_t CubeStatus::permRank(int first, int n, int base) const {
+        // Blocks seen so far, by position. The popcount of the higher bits replaces the inner loop of the
+        // plain inversion count.
+        uint32_t seen = 0;
+        uint64_t co = 0;
+        for (int i = 0; i < n; ++i) {
+            int pos = move_[first + i].pos() - base;
+            co += std::popcount(seen >> pos) * static_cast<uint64_t>(Constants.factorial_[i]);
+            seen |= 1u << pos;
         }
         return co;
     }
 
-    uint64_t CubeStatus::getEdgePermCoord() {
-        int co = 0;
-
-        for (int i = BlockPos::BR; i > BlockPos::UR; --i) {
-            int s = 0;
-            for (int j = i - 1; j >= BlockPos::UR; --j) {
-                if (move_[j].pos_ > move_[i].pos_) {
-                    s += 1;
-                }
-            }
-            // (i + 1 - BlockPos::UR) is the order of this edge.
-            co = (co + s) * (i + 1 - BlockPos::UR);
+    constexpr uint32_t CubeStatus::udSliceMask() const {
+        uint32_t mask = 0;
+        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
+            mask |= static_cast<uint32_t>(move_[i].pos() >= BlockPos::FR) << (i - BlockPos::UR);
         }
-        return co;
+        return mask;
     }
 
-    uint64_t CubeStatus::getUDSliceCoord() {
-        bool occupied[12];
-        std::fill(occupied, occupied + 12, false);
-        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
-            if (move_[i].pos_ >= BlockPos::FR) {
-                occupied[i - BlockPos::UR] = true;
-            }
+    constexpr uint64_t CubeStatus::getConorPermCoord() const {
+        return permRank(BlockPos::URF, 8, BlockPos::URF);
+    }
+
+    constexpr uint64_t CubeStatus::getEdgePermCoord() const {
+        return permRank(BlockPos::UR, 12, BlockPos::UR);
+    }
+
+    constexpr uint64_t CubeStatus::getUDSliceCoord() const {
+        return UDSliceRank_[udSliceMask()];
+    }
+
+    constexpr uint64_t CubeStatus::getPhase2EdgePermCoord() const {
+        // The edges UR..DB, at any of the 12 edge positions outside G1.
+        return permRank(BlockPos::UR, 8, BlockPos::UR);
+    }
+
+    constexpr uint64_t CubeStatus::getUDSliceSortedCoord() const {
+        // Rank of the slice edges in the order of their positions, as permRank.
+        uint32_t mask = udSliceMask();
+        uint32_t seen = 0;
+        uint64_t co = 0;
+        int j = 0;
+        for (uint32_t rest = mask; rest != 0; rest &= rest - 1, ++j) {
+            int e = move_[BlockPos::UR + std::countr_zero(rest)].pos() - BlockPos::FR;
+            co += std::popcount(seen >> e) * static_cast<uint64_t>(Constants.factorial_[j]);
+            seen |= 1u << e;
         }
-        uint64_t s = 0;
-        int k = 3, n = 11;
-        ConstantFactory &constantFactory = ConstantFactory::getInstance();
-        while (k >= 0) {
-            if (occupied[n]) {
-                k -= 1;
-                n -= 1;
+        return co + 24ULL * UDSliceRank_[mask];
+    }
+
+    constexpr uint64_t CubeStatus::getUEdgesCoord() const {
+        return layerEdgesCoord(BlockPos::UR);
+    }
+
+    constexpr uint64_t CubeStatus::getDEdgesCoord() const {
+        return layerEdgesCoord(BlockPos::DR);
+    }
+
+    constexpr uint64_t CubeStatus::layerEdgesCoord(int first) const {
+        uint32_t seen = 0;
+        uint64_t comb = 0, co = 0;
+        int j = 0;
+        for (int i = 0; i < 12; ++i) {
+            int e = move_[BlockPos::UR + i].pos() - first;
+            if (e < 0 || e >= 4) {
                 continue;
             }
-            s += static_cast<uint64_t>(constantFactory.getBiCoef(n, k));
-            n -= 1;
+            comb += static_cast<uint64_t>(ConstantFactory::getBiCoef(i, j + 1));
+            co += std::popcount(seen >> e) * static_cast<uint64_t>(Constants.factorial_[j]);
+            seen |= 1u << e;
+            j += 1;
         }
-        return s;
+        return co + 24 * comb;
     }
 
-    uint64_t CubeStatus::getPhase2EdgePermCoord() {
-        int co = 0;
-        for (int i = BlockPos::DB; i > BlockPos::UR; --i) {
-            int s = 0;
-            for (int j = i - 1; j >= BlockPos::UR; --j) {
-                if (move_[j].pos_ > move_[i].pos_) {
-                    s += 1;
+    constexpr std::array<uint16_t, 1 << 12> CubeStatus::makeUDSliceRank() {
+        std::array<uint16_t, 1 << 12> rank{};
+        for (uint32_t mask = 0; mask < rank.size(); ++mask) {
+            if (std::popcount(mask) != 4) {
+                continue;
+            }
+            uint64_t s = 0;
+            int k = 3, n = 11;
+            while (k >= 0) {
+                if ((mask >> n & 1) != 0) {
+                    k -= 1;
+                    n -= 1;
+                    continue;
                 }
+                s += static_cast<uint64_t>(ConstantFactory::getBiCoef(n, k));
+                n -= 1;
             }
-            // (i + 1 - BlockPos::UR) is the order of this edge.
-            co = (s + co) * (i + 1 - BlockPos::UR);
+            rank[mask] = static_cast<uint16_t>(s);
         }
-        return co;
+        return rank;
     }
 
-    uint64_t CubeStatus::getUDSliceSortedCoord() {
-        BlockPos arr[4];
-        int j = 0;
-        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
-            BlockPos e = move_[i].pos_;
-            if (e == BlockPos::FR || e == BlockPos::FL || e == BlockPos::BL || e == BlockPos::BR) {
-                arr[j] = e;
-                j += 1;
-            }
+    inline constexpr std::array<uint16_t, 1 << 12> CubeStatus::UDSliceRank_ = makeUDSliceRank();
+
+    constexpr CubeStatus &CubeStatus::operator*=(const CubeStatus &other) {
+#ifdef __AVX2__
+        if (!std::is_constant_evaluated()) {
+            composeAvx2(other);
+            return *this;
         }
+#endif
+        composeScalar(other);
+        return *this;
+    }
 
-        uint64_t co = 0;
-        for (j = 3; j >= 1; --j) {
-            int s = 0;
-            for (int k = j - 1; k >= 0; --k) {
-                if (arr[k] > arr[j]) {
-                    s += 1;
+    constexpr void CubeStatus::composeScalar(const CubeStatus &other) {
+        for (int i = BlockPos::URF; i <= BlockPos::BR; ++i) {
+            BlockPos thisPos = this->move_[i].pos();
+            int8_t thisOri = this->move_[i].ori();
+            int8_t otherOri = other.move_[thisPos].ori();
+            int8_t ori;
+            if (i >= BlockPos::UR) {
+                ori = static_cast<int8_t>(thisOri ^ otherOri);
+            } else if (thisOri < 3 && otherOri < 3) {
+                ori = static_cast<int8_t>(thisOri + otherOri);
+                if (ori >= 3) {
+                    ori -= 3;
                 }
+            } else {
+                ori = mirroredConorOri(thisOri, otherOri);
             }
-            co = (co + s) * j;
+            this->move_[i] = MoveResult(other.move_[thisPos].pos(), ori);
         }
-        co = co + 24ULL * getUDSliceCoord();
-        return co;
     }
 
-    CubeStatus &CubeStatus::operator*=(const CubeStatus &other) {
-#ifdef DEBUG
-        //            std::cout << "operator*=" << std::endl;
+#ifdef __AVX2__
+    void CubeStatus::composeAvx2(const CubeStatus &other) {
+        const __m256i posMask = _mm256_set1_epi8(MoveResult::PosMask);
+        const __m256i oriMask = _mm256_set1_epi8(7);
+        const __m256i conorMask = _mm256_setr_epi64x(-1, 0, 0, 0);
+        const __m256i blockMask = _mm256_setr_epi32(-1, -1, -1, -1, -1, 0, 0, 0);
+        // Conor orientation o is the twist o % 3, mirrored if o >= 3.
+        const __m256i twistOf = _mm256_broadcastsi128_si256(
+                _mm_setr_epi8(0, 1, 2, 0, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+        const __m256i mirrorOf = _mm256_broadcastsi128_si256(
+                _mm_setr_epi8(0, 0, 0, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+        const __m256i negTwist = _mm256_broadcastsi128_si256(
+                _mm_setr_epi8(0, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+        const __m256i mod3 = _mm256_broadcastsi128_si256(
+                _mm_setr_epi8(0, 1, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(this->move_));
+        __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i *>(other.move_));
+
+        // other.move_[thisPos]. Shuffles stay within 128-bit lanes, so look up in each half of other copied
+        // to both lanes, and take the upper half for positions 16 and above.
+        __m256i thisPos = _mm256_and_si256(a, posMask);
+        __m256i lo = _mm256_broadcastsi128_si256(_mm256_castsi256_si128(b));
+        __m256i hi = _mm256_broadcastsi128_si256(_mm256_extracti128_si256(b, 1));
+        __m256i picked = _mm256_blendv_epi8(_mm256_shuffle_epi8(lo, thisPos), _mm256_shuffle_epi8(hi, thisPos),
+                                            _mm256_cmpgt_epi8(thisPos, _mm256_set1_epi8(15)));
+
+        __m256i thisOri = _mm256_and_si256(_mm256_srli_epi16(a, MoveResult::OriShift), oriMask);
+        __m256i otherOri = _mm256_and_si256(_mm256_srli_epi16(picked, MoveResult::OriShift), oriMask);
+
+        // Twists add, except that a mirrored other reverses the twist of this. The result is mirrored if
+        // exactly one side is.
+        __m256i thisTwist = _mm256_shuffle_epi8(twistOf, thisOri);
+        __m256i otherMirror = _mm256_shuffle_epi8(mirrorOf, otherOri);
+        thisTwist = _mm256_blendv_epi8(thisTwist, _mm256_shuffle_epi8(negTwist, thisTwist), otherMirror);
+        __m256i twist = _mm256_shuffle_epi8(mod3, _mm256_add_epi8(thisTwist, _mm256_shuffle_epi8(twistOf, otherOri)));
+        __m256i mirror = _mm256_xor_si256(_mm256_shuffle_epi8(mirrorOf, thisOri), otherMirror);
+        __m256i conorOri = _mm256_add_epi8(twist, _mm256_and_si256(mirror, _mm256_set1_epi8(3)));
+        __m256i edgeOri = _mm256_xor_si256(thisOri, otherOri);
+        __m256i ori = _mm256_blendv_epi8(edgeOri, conorOri, conorMask);
+
+        // Orientations are below 8, so shifting 16-bit words does not carry into the next byte.
+        __m256i res = _mm256_or_si256(_mm256_and_si256(picked, posMask), _mm256_slli_epi16(ori, MoveResult::OriShift));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(this->move_), _mm256_and_si256(res, blockMask));
+    }
 #endif
-        for (int i = BlockPos::URF; i <= BlockPos::BR; ++i) {
-            BlockPos thisPos = this->move_[i].pos_;
-            int8_t thisOri = this->move_[i].ori_;
-            this->move_[i].pos_ = other.move_[thisPos].pos_;
-            this->move_[i].ori_ = thisOri + other.move_[thisPos].ori_;
-            if (i <= BlockPos::DRB && this->move_[i].ori_ >= 3) {
-                this->move_[i].ori_ -= 3;
-            } else if (i >= BlockPos::UR && this->move_[i].ori_ >= 2) {
-                this->move_[i].ori_ -= 2;
+
+    constexpr int8_t CubeStatus::mirroredConorOri(int8_t thisOri, int8_t otherOri) {
+        int8_t ori;
+        if (thisOri >= 3 && otherOri < 3) {
+            // The composition is mirrored.
+            ori = static_cast<int8_t>(otherOri + thisOri);
+            if (ori >= 6) {
+                ori -= 3;
+            }
+        } else if (thisOri < 3) {
+            // The composition is mirrored.
+            ori = static_cast<int8_t>(otherOri - thisOri);
+            if (ori < 3) {
+                ori += 3;
+            }
+        } else {
+            // Both are mirrored, the composition is regular.
+            ori = static_cast<int8_t>(otherOri - thisOri);
+            if (ori < 0) {
+                ori += 3;
             }
         }
-        return *this;
+        return ori;
     }
 
-    CubeStatus CubeStatus::operator*(const CubeStatus &other) const {
+    constexpr CubeStatus CubeStatus::operator*(const CubeStatus &other) const {
         auto ret = CubeStatus(*this);
         ret *= other;
         return ret;
     }
 
-    CubeStatus CubeStatus::inverse() const {
+    constexpr CubeStatus CubeStatus::inverse() const {
         CubeStatus ret;
         for (int i = BlockPos::URF; i <= BlockPos::BR; ++i) {
-            ret.move_[this->move_[i].pos_].pos_ = static_cast<BlockPos>(i);
-            ret.move_[this->move_[i].pos_].ori_ = static_cast<int8_t>(3) - this->move_[i].ori_;
-            if (ret.move_[i].ori_ >= 3) {
-                ret.move_[i].ori_ -= 3;
+            int8_t ori = this->move_[i].ori();
+            if (i < BlockPos::UR && ori < 3) {
+                // A twist is undone by the opposite twist, while mirrored conor orientations and edge flips
+                // are their own inverses.
+                ori = static_cast<int8_t>((3 - ori) % 3);
             }
+            ret.move_[this->move_[i].pos()] = MoveResult(i, ori);
         }
         return ret;
     }
 
-    bool CubeStatus::operator==(const CubeStatus &c) const {
-        for (int i = 0; i <= BlockPos::BR; ++i) {
-            if (this->move_[i] != c.move_[i]) {
-                return false;
-            }
+    constexpr bool CubeStatus::operator==(const CubeStatus &c) const {
+        if (std::is_constant_evaluated()) {
+            return std::equal(this->move_, this->move_ + 32, c.move_);
         }
-        return true;
+        // The padding is always zero.
+        return std::memcmp(this->move_, c.move_, sizeof(move_)) == 0;
     }
 
-    bool CubeStatus::operator!=(const CubeStatus &c) const {
+    constexpr bool CubeStatus::operator!=(const CubeStatus &c) const {
         return !this->operator==(c);
     }
 
@@ -315,7 +551,7 @@ namespace Cube {
         return INSTANCE;
     }
 
-    CubeStatus &MoveFactory::getMoveByEnum(BasicMoveName m) {
+    constexpr const CubeStatus &MoveFactory::getMoveByEnum(BasicMoveName m) {
         switch (m) {
             case BasicMoveName::U:
                 return U_;
@@ -334,48 +570,100 @@ namespace Cube {
         }
     }
 
+    constexpr const CubeStatus &MoveFactory::getMoveByName(MoveName m) {
+        return Moves_[m];
+    }
+
     CubeStatus MoveFactory::genRandomCube(uint64_t randomStep) {
-        auto &randomFactory = RandomFactory::getInstance();
+        auto &engine = RandomFactory::generator();
         CubeStatus cur = Id_;
-        std::uniform_int_distribution<> dist;
+        int last = NoMove;
         while (randomStep-- > 0) {
-#ifdef DEBUG
-//            std::cout << "randomStep: " << randomStep << std::endl;
-#endif
-            auto move_Enum = static_cast<BasicMoveName>(dist(randomFactory.generator_) % 6);
-            CubeStatus move_ = getMoveByEnum(move_Enum);
-            cur *= move_;
+            uint32_t allowed = NextMoves_[last];
+            // Pick the k-th allowed move.
+            int k = std::uniform_int_distribution<int>(0, std::popcount(allowed) - 1)(engine);
+            while (k-- > 0) {
+                allowed &= allowed - 1;
+            }
+            last = std::countr_zero(allowed);
+            cur = Moves_[last] * cur;
         }
         return cur;
     }
 
-    MoveFactory::MoveFactory() {
-        // Init id move_
-        setAsId(Id_);
-
-        // Init basic move_s
-        setAsU(U_);
-        setAsD(D_);
-        setAsL(L_);
-        setAsR(R_);
-        setAsF(F_);
-        setAsB(B_);
-
-        // Init inverse of basic move_s
-        //            Li = L_.inverse();
-        //            Ri = R_.inverse();
-        //            Ui = U_.inverse();
-        //            Di = D_.inverse();
-        //            Fi = F_.inverse();
-        //            Bi = B_.inverse();
-
-        // Init basic symmetric move_s
-        setAsS_URF3(S_URF3);
-        setAsS_F2(S_F2);
-        setAsS_U4(S_U4);
-        setAsS_LR2(S_LR2);
-
-        // Init all symmetric move_s
+    int MoveFactory::simplifyMoves(MoveName *moves, int length) {
+        // moves[0, n) is simplified.
+        int n = 0;
+        for (int i = 0; i < length; ++i) {
+            int face = moves[i] / 3;
+            int j = n - 1;
+            if (j >= 0 && moves[j] / 3 == (face ^ 1)) {
+                j -= 1;
+            }
+            if (j < 0 || moves[j] / 3 != face) {
+                moves[n++] = moves[i];
+                continue;
+            }
+            // Quarter turns add up modulo 4.
+            int power = (moves[j] % 3 + moves[i] % 3 + 2) % 4;
+            if (power != 0) {
+                moves[j] = static_cast<MoveName>(3 * face + power - 1);
+            } else {
+                std::copy(moves + j + 1, moves + n, moves + j);
+                n -= 1;
+            }
+        }
+        return n;
+    }
+
+    CubeStatus MoveFactory::genUniformCube(RandomFactory::Engine &engine) {
+        constexpr uint64_t TwistCnt = 2187, FlipCnt = 2048, ConorPermCnt = 40320, EdgePermCnt = 479001600;
+        auto conorPerm = std::uniform_int_distribution<uint64_t>(0, ConorPermCnt - 1)(engine);
+        auto edgePerm = std::uniform_int_distribution<uint64_t>(0, EdgePermCnt - 1)(engine);
+        auto res = getByConorOriCoord(std::uniform_int_distribution<uint64_t>(0, TwistCnt - 1)(engine));
+        auto flip = getByEdgeOriCoord(std::uniform_int_distribution<uint64_t>(0, FlipCnt - 1)(engine));
+        BlockPos perm[12];
+        decodePerm(conorPerm, 8, BlockPos::URF, perm);
+        for (int i = BlockPos::URF; i <= BlockPos::DRB; ++i) {
+            res.move_[i].setPos(perm[i - BlockPos::URF]);
+        }
+        decodePerm(edgePerm, 12, BlockPos::UR, perm);
+        // Swapping two edges maps the odd permutations one to one onto the even ones, so the result stays
+        // uniform.
+        if (permParity(conorPerm, 8) != permParity(edgePerm, 12)) {
+            std::swap(perm[0], perm[1]);
+        }
+        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
+            res.move_[i] = MoveResult(perm[i - BlockPos::UR], flip.move_[i].ori());
+        }
+        return res;
+    }
+
+    CubeStatus MoveFactory::genUniformCube() {
+        return genUniformCube(RandomFactory::generator());
+    }
+
+    constexpr CubeStatus MoveFactory::makeCube(void (*setAs)(CubeStatus &)) {
+        CubeStatus m;
+        setAs(m);
+        return m;
+    }
+
+    constexpr std::array<CubeStatus, 18> MoveFactory::makeMoves() {
+        std::array<CubeStatus, 18> moves;
+        for (int face = 0; face <= BasicMoveName::R; ++face) {
+            auto &m = getMoveByEnum(static_cast<BasicMoveName>(face));
+            CubeStatus cur = Id_;
+            for (int j = 0; j < 3; ++j) {
+                cur = m * cur;
+                moves[3 * face + j] = cur;
+            }
+        }
+        return moves;
+    }
+
+    constexpr std::array<CubeStatus, 48> MoveFactory::makeSyms() {
+        std::array<CubeStatus, 48> syms;
         for (int a = 0; a < 3; ++a) {
             for (int b = 0; b < 2; ++b) {
                 for (int c = 0; c < 4; ++c) {
@@ -394,21 +682,61 @@ namespace Cube {
                         for (int i = 0; i < d; ++i) {
                             S *= S_LR2;
                         }
-                        Sym_[idx] = S;
+                        syms[idx] = S;
                     }
                 }
             }
         }
+        return syms;
     }
 
-    void MoveFactory::setAsId(CubeStatus &m) {
+    constexpr std::array<uint32_t, MoveFactory::NoMove + 1> MoveFactory::makeNextMoves() {
+        std::array<uint32_t, NoMove + 1> next{};
+        for (int last = 0; last <= NoMove; ++last) {
+            int lastFace = last == NoMove ? -1 : last / 3;
+            for (int m = 0; m < 18; ++m) {
+                // Faces are numbered U, D, F, B, L, R, so opposite faces differ in the lowest bit.
+                if (m / 3 != lastFace && !((m / 3 ^ 1) == lastFace && m / 3 < lastFace)) {
+                    next[last] |= 1u << m;
+                }
+            }
+        }
+        return next;
+    }
+
+    constexpr std::array<int, 48> MoveFactory::makeSymInv() {
+        std::array<int, 48> symInv{};
+        for (int s = 0; s < 48; ++s) {
+            for (int t = 0; t < 48; ++t) {
+                if (Sym_[s] * Sym_[t] == Id_) {
+                    symInv[s] = t;
+                    break;
+                }
+            }
+        }
+        return symInv;
+    }
+
+    constexpr CubeStatus MoveFactory::conjugate(const CubeStatus &c, int s) {
+        return Sym_[SymInv_[s]] * c * Sym_[s];
+    }
+
+    constexpr MoveName MoveFactory::conjugateMove(MoveName m, int s) {
+        auto c = conjugate(Moves_[m], SymInv_[s]);
+        int k = 0;
+        while (Moves_[k] != c) {
+            k += 1;
+        }
+        return static_cast<MoveName>(k);
+    }
+
+    constexpr void MoveFactory::setAsId(CubeStatus &m) {
         for (int i = BlockPos::URF; i <= BlockPos::BR; ++i) {
-            m.move_[i].pos_ = static_cast<BlockPos>(i);
-            m.move_[i].ori_ = 0;
+            m.move_[i] = MoveResult(i, 0);
         }
     }
 
-    void MoveFactory::setAsL(CubeStatus &m) {
+    constexpr void MoveFactory::setAsL(CubeStatus &m) {
 
         m.move_[URF] = MoveResult(URF, 0);
         m.move_[UFL] = MoveResult(ULB, 1);
@@ -433,7 +761,7 @@ namespace Cube {
         m.move_[BR] = MoveResult(BR, 0);
     }
 
-    void MoveFactory::setAsR(CubeStatus &m) {
+    constexpr void MoveFactory::setAsR(CubeStatus &m) {
         m.move_[URF] = MoveResult(DFR, 2);
         m.move_[UFL] = MoveResult(UFL, 0);
         m.move_[ULB] = MoveResult(ULB, 0);
@@ -458,7 +786,7 @@ namespace Cube {
 
     }
 
-    void MoveFactory::setAsU(CubeStatus &m) {
+    constexpr void MoveFactory::setAsU(CubeStatus &m) {
         m.move_[URF] = MoveResult(UBR, 0);
         m.move_[UFL] = MoveResult(URF, 0);
         m.move_[ULB] = MoveResult(UFL, 0);
@@ -483,7 +811,7 @@ namespace Cube {
         m.move_[BR] = MoveResult(BR, 0);
     }
 
-    void MoveFactory::setAsD(CubeStatus &m) {
+    constexpr void MoveFactory::setAsD(CubeStatus &m) {
 
         m.move_[URF] = MoveResult(URF, 0);
         m.move_[UFL] = MoveResult(UFL, 0);
@@ -508,7 +836,7 @@ namespace Cube {
         m.move_[BR] = MoveResult(BR, 0);
     }
 
-    void MoveFactory::setAsF(CubeStatus &m) {
+    constexpr void MoveFactory::setAsF(CubeStatus &m) {
         m.move_[URF] = MoveResult(UFL, 1);
         m.move_[UFL] = MoveResult(DLF, 2);
         m.move_[ULB] = MoveResult(ULB, 0);
@@ -532,7 +860,7 @@ namespace Cube {
         m.move_[BR] = MoveResult(BR, 0);
     }
 
-    void MoveFactory::setAsB(CubeStatus &m) {
+    constexpr void MoveFactory::setAsB(CubeStatus &m) {
 
         m.move_[URF] = MoveResult(URF, 0);
         m.move_[UFL] = MoveResult(UFL, 0);
@@ -557,33 +885,116 @@ namespace Cube {
         m.move_[BR] = MoveResult(DB, 1);
     }
 
-    void MoveFactory::setAsS_URF3(CubeStatus &m) {
-        // TODO
+    constexpr void MoveFactory::setAsS_URF3(CubeStatus &m) {
+        // 120 degree clockwise rotation around the long diagonal URF-DBL.
+        m.move_[URF] = MoveResult(URF, 1);
+        m.move_[UFL] = MoveResult(DFR, 2);
+        m.move_[ULB] = MoveResult(DLF, 1);
+        m.move_[UBR] = MoveResult(UFL, 2);
+        m.move_[DFR] = MoveResult(UBR, 2);
+        m.move_[DLF] = MoveResult(DRB, 1);
+        m.move_[DBL] = MoveResult(DBL, 2);
+        m.move_[DRB] = MoveResult(ULB, 1);
+
+        m.move_[UR] = MoveResult(UF, 1);
+        m.move_[UF] = MoveResult(FR, 0);
+        m.move_[UL] = MoveResult(DF, 1);
+        m.move_[UB] = MoveResult(FL, 0);
+        m.move_[DR] = MoveResult(UB, 1);
+        m.move_[DF] = MoveResult(BR, 0);
+        m.move_[DL] = MoveResult(DB, 1);
+        m.move_[DB] = MoveResult(BL, 0);
+        m.move_[FR] = MoveResult(UR, 1);
+        m.move_[FL] = MoveResult(DR, 1);
+        m.move_[BL] = MoveResult(DL, 1);
+        m.move_[BR] = MoveResult(UL, 1);
     }
 
-    void MoveFactory::setAsS_F2(CubeStatus &m) {
-        // TODO
+    constexpr void MoveFactory::setAsS_F2(CubeStatus &m) {
+        // 180 degree rotation around the axis through the F and B centers.
+        m.move_[URF] = MoveResult(DLF, 0);
+        m.move_[UFL] = MoveResult(DFR, 0);
+        m.move_[ULB] = MoveResult(DRB, 0);
+        m.move_[UBR] = MoveResult(DBL, 0);
+        m.move_[DFR] = MoveResult(UFL, 0);
+        m.move_[DLF] = MoveResult(URF, 0);
+        m.move_[DBL] = MoveResult(UBR, 0);
+        m.move_[DRB] = MoveResult(ULB, 0);
+
+        m.move_[UR] = MoveResult(DL, 0);
+        m.move_[UF] = MoveResult(DF, 0);
+        m.move_[UL] = MoveResult(DR, 0);
+        m.move_[UB] = MoveResult(DB, 0);
+        m.move_[DR] = MoveResult(UL, 0);
+        m.move_[DF] = MoveResult(UF, 0);
+        m.move_[DL] = MoveResult(UR, 0);
+        m.move_[DB] = MoveResult(UB, 0);
+        m.move_[FR] = MoveResult(FL, 0);
+        m.move_[FL] = MoveResult(FR, 0);
+        m.move_[BL] = MoveResult(BR, 0);
+        m.move_[BR] = MoveResult(BL, 0);
     }
 
-    void MoveFactory::setAsS_U4(CubeStatus &m) {
-        // TODO
+    constexpr void MoveFactory::setAsS_U4(CubeStatus &m) {
+        // 90 degree clockwise rotation around the axis through the U and D centers.
+        m.move_[URF] = MoveResult(UBR, 0);
+        m.move_[UFL] = MoveResult(URF, 0);
+        m.move_[ULB] = MoveResult(UFL, 0);
+        m.move_[UBR] = MoveResult(ULB, 0);
+        m.move_[DFR] = MoveResult(DRB, 0);
+        m.move_[DLF] = MoveResult(DFR, 0);
+        m.move_[DBL] = MoveResult(DLF, 0);
+        m.move_[DRB] = MoveResult(DBL, 0);
+
+        m.move_[UR] = MoveResult(UB, 0);
+        m.move_[UF] = MoveResult(UR, 0);
+        m.move_[UL] = MoveResult(UF, 0);
+        m.move_[UB] = MoveResult(UL, 0);
+        m.move_[DR] = MoveResult(DB, 0);
+        m.move_[DF] = MoveResult(DR, 0);
+        m.move_[DL] = MoveResult(DF, 0);
+        m.move_[DB] = MoveResult(DL, 0);
+        m.move_[FR] = MoveResult(BR, 1);
+        m.move_[FL] = MoveResult(FR, 1);
+        m.move_[BL] = MoveResult(FL, 1);
+        m.move_[BR] = MoveResult(BL, 1);
     }
 
-    void MoveFactory::setAsS_LR2(CubeStatus &m) {
-        // TODO
+    constexpr void MoveFactory::setAsS_LR2(CubeStatus &m) {
+        // Reflection at the plane through the U, D, F and B centers. Conor orientations of mirrored cubes are 3..5.
+        m.move_[URF] = MoveResult(UFL, 3);
+        m.move_[UFL] = MoveResult(URF, 3);
+        m.move_[ULB] = MoveResult(UBR, 3);
+        m.move_[UBR] = MoveResult(ULB, 3);
+        m.move_[DFR] = MoveResult(DLF, 3);
+        m.move_[DLF] = MoveResult(DFR, 3);
+        m.move_[DBL] = MoveResult(DRB, 3);
+        m.move_[DRB] = MoveResult(DBL, 3);
+
+        m.move_[UR] = MoveResult(UL, 0);
+        m.move_[UF] = MoveResult(UF, 0);
+        m.move_[UL] = MoveResult(UR, 0);
+        m.move_[UB] = MoveResult(UB, 0);
+        m.move_[DR] = MoveResult(DL, 0);
+        m.move_[DF] = MoveResult(DF, 0);
+        m.move_[DL] = MoveResult(DR, 0);
+        m.move_[DB] = MoveResult(DB, 0);
+        m.move_[FR] = MoveResult(FL, 0);
+        m.move_[FL] = MoveResult(FR, 0);
+        m.move_[BL] = MoveResult(BR, 0);
+        m.move_[BR] = MoveResult(BL, 0);
     }
 
-    CubeStatus MoveFactory::getByUDSliceCoord(uint64_t coord) {
+    constexpr CubeStatus MoveFactory::getByUDSliceCoord(uint64_t coord) {
         auto res = Id_;
-        auto &CONSTANTS = ConstantFactory::getInstance();
         bool occ[12];
 
         std::fill(occ, occ + 12, false);
         int pos = 11;
         uint64_t cur = coord;
         for (int j = 3; j >= 0; --j) {
-            while (cur >= CONSTANTS.getBiCoef(pos, j)) {
-                cur -= CONSTANTS.getBiCoef(pos, j);
+            while (cur >= static_cast<uint64_t>(ConstantFactory::getBiCoef(pos, j))) {
+                cur -= ConstantFactory::getBiCoef(pos, j);
                 pos--;
             }
             occ[pos--] = true;
@@ -601,6 +1012,149 @@ namespace Cube {
         }
         return res;
     }
+
+    constexpr CubeStatus MoveFactory::getByConorOriCoord(uint64_t coord) {
+        auto res = Id_;
+        int paritySum = 0;
+        // The last conor is determined by the others.
+        for (int i = BlockPos::DRB - 1; i >= BlockPos::URF; --i) {
+            res.move_[i].setOri(static_cast<int8_t>(coord % 3));
+            paritySum += res.move_[i].ori();
+            coord /= 3;
+        }
+        res.move_[BlockPos::DRB].setOri(static_cast<int8_t>((3 - paritySum % 3) % 3));
+        return res;
+    }
+
+    constexpr CubeStatus MoveFactory::getByEdgeOriCoord(uint64_t coord) {
+        auto res = Id_;
+        int paritySum = 0;
+        // The last edge is determined by the others.
+        for (int i = BlockPos::BR - 1; i >= BlockPos::UR; --i) {
+            res.move_[i].setOri(static_cast<int8_t>(coord % 2));
+            paritySum += res.move_[i].ori();
+            coord /= 2;
+        }
+        res.move_[BlockPos::BR].setOri(static_cast<int8_t>(paritySum % 2));
+        return res;
+    }
+
+    constexpr void MoveFactory::decodePerm(uint64_t coord, int n, BlockPos first, BlockPos *out) {
+        // digit[i] is the number of blocks left of position i which are greater than the one at i.
+        int digit[12];
+        for (int i = 1; i < n; ++i) {
+            digit[i] = static_cast<int>(coord % (i + 1));
+            coord /= (i + 1);
+        }
+        digit[0] = 0;
+        // Remaining blocks in descending order.
+        BlockPos rest[12];
+        for (int i = 0; i < n; ++i) {
+            rest[i] = static_cast<BlockPos>(first + n - 1 - i);
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            out[i] = rest[digit[i]];
+            std::copy(rest + digit[i] + 1, rest + i + 1, rest + digit[i]);
+        }
+    }
+
+    constexpr int MoveFactory::permParity(uint64_t coord, int n) {
+        // The digits of the coordinate count the inversions.
+        int inversions = 0;
+        for (int i = 1; i < n; ++i) {
+            inversions += static_cast<int>(coord % (i + 1));
+            coord /= (i + 1);
+        }
+        return inversions & 1;
+    }
+
+    constexpr CubeStatus MoveFactory::getByConorPermCoord(uint64_t coord) {
+        auto res = Id_;
+        BlockPos perm[8];
+        decodePerm(coord, 8, BlockPos::URF, perm);
+        for (int i = BlockPos::URF; i <= BlockPos::DRB; ++i) {
+            res.move_[i].setPos(perm[i - BlockPos::URF]);
+        }
+        return res;
+    }
+
+    constexpr CubeStatus MoveFactory::getByPhase2EdgePermCoord(uint64_t coord) {
+        auto res = Id_;
+        BlockPos perm[8];
+        decodePerm(coord, 8, BlockPos::UR, perm);
+        for (int i = BlockPos::UR; i <= BlockPos::DB; ++i) {
+            res.move_[i].setPos(perm[i - BlockPos::UR]);
+        }
+        return res;
+    }
+
+    constexpr CubeStatus MoveFactory::getByUDSliceSortedCoord(uint64_t coord) {
+        auto res = getByUDSliceCoord(coord / 24);
+        BlockPos perm[4];
+        decodePerm(coord % 24, 4, BlockPos::FR, perm);
+        int j = 0;
+        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
+            if (res.move_[i].pos() >= BlockPos::FR) {
+                res.move_[i].setPos(perm[j++]);
+            }
+        }
+        return res;
+    }
+
+    constexpr CubeStatus MoveFactory::getByUEdgesCoord(uint64_t coord) {
+        return getByLayerEdgesCoord(coord, BlockPos::UR);
+    }
+
+    constexpr CubeStatus MoveFactory::getByDEdgesCoord(uint64_t coord) {
+        return getByLayerEdgesCoord(coord, BlockPos::DR);
+    }
+
+    constexpr CubeStatus MoveFactory::getByLayerEdgesCoord(uint64_t coord, int first) {
+        // Positions of the four edges, the largest first.
+        bool occ[12] = {};
+        uint64_t comb = coord / 24;
+        int pos = 11;
+        for (int j = 3; j >= 0; --j) {
+            while (static_cast<uint64_t>(ConstantFactory::getBiCoef(pos, j + 1)) > comb) {
+                pos -= 1;
+            }
+            comb -= static_cast<uint64_t>(ConstantFactory::getBiCoef(pos, j + 1));
+            occ[pos--] = true;
+        }
+
+        BlockPos perm[4];
+        decodePerm(coord % 24, 4, static_cast<BlockPos>(first), perm);
+        auto res = Id_;
+        int j = 0;
+        int other = BlockPos::UR;
+        for (int i = 0; i < 12; ++i) {
+            if (occ[i]) {
+                res.move_[BlockPos::UR + i].setPos(perm[j++]);
+            } else {
+                // The other edges in any order.
+                other += other == first ? 4 : 0;
+                res.move_[BlockPos::UR + i].setPos(static_cast<BlockPos>(other++));
+            }
+        }
+        return res;
+    }
+
+    // The constant cubes, in dependency order.
+    inline constexpr CubeStatus MoveFactory::Id_ = makeCube(setAsId);
+    inline constexpr CubeStatus MoveFactory::L_ = makeCube(setAsL);
+    inline constexpr CubeStatus MoveFactory::R_ = makeCube(setAsR);
+    inline constexpr CubeStatus MoveFactory::U_ = makeCube(setAsU);
+    inline constexpr CubeStatus MoveFactory::D_ = makeCube(setAsD);
+    inline constexpr CubeStatus MoveFactory::F_ = makeCube(setAsF);
+    inline constexpr CubeStatus MoveFactory::B_ = makeCube(setAsB);
+    inline constexpr CubeStatus MoveFactory::S_URF3 = makeCube(setAsS_URF3);
+    inline constexpr CubeStatus MoveFactory::S_F2 = makeCube(setAsS_F2);
+    inline constexpr CubeStatus MoveFactory::S_U4 = makeCube(setAsS_U4);
+    inline constexpr CubeStatus MoveFactory::S_LR2 = makeCube(setAsS_LR2);
+    inline constexpr std::array<CubeStatus, 18> MoveFactory::Moves_ = makeMoves();
+    inline constexpr std::array<CubeStatus, 48> MoveFactory::Sym_ = makeSyms();
+    inline constexpr std::array<int, 48> MoveFactory::SymInv_ = makeSymInv();
+    inline constexpr std::array<uint32_t, MoveFactory::NoMove + 1> MoveFactory::NextMoves_ = makeNextMoves();
 }
 
 
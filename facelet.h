@@ -0,0 +1,210 @@
+#ifndef CUBE_SOLVER_FACELET_H
+#define CUBE_SOLVER_FACELET_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+#include "utility.h"
+#include "cube_def.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Facelet strings, 54 face letters for the faces U, R, F, D, L, B in this order, each read row by row
+     * as seen from the front of that face, with U and D seen with F at their bottom and top edge. This is
+     * the format of Kociemba's tools, the solved cube being "UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBB".
+     *
+     * Parsing looks each corner and edge up by its colors in small tables, and rejects strings which are
+     * not a solvable cube.
+     * */
+    class Facelets {
+    public:
+        static constexpr int FaceletCnt = 54;
+
+        Facelets() = delete;
+
+        // Throws std::invalid_argument on malformed or unsolvable input.
+        static CubeStatus parse(std::string_view facelets);
+
+        // Write the FaceletCnt letters of c, which must not be mirrored, to out.
+        static void serialize(const CubeStatus &c, char *out);
+
+        static std::string toString(const CubeStatus &c);
+
+    protected:
+        // Faces in facelet order, each taking 9 consecutive facelets.
+        enum Face : uint8_t {
+            FaceU, FaceR, FaceF, FaceD, FaceL, FaceB, NoFace
+        };
+
+        static constexpr char FaceName[6] = {'U', 'R', 'F', 'D', 'L', 'B'};
+
+        // Facelets of each corner, starting with the U or D one and going clockwise.
+        static constexpr uint8_t ConorFacelet[8][3] = {
+                {8,  9,  20}, {6,  18, 38}, {0,  36, 47}, {2,  45, 11},
+                {29, 26, 15}, {27, 44, 24}, {33, 53, 42}, {35, 17, 51}};
+        // Facelets of each edge, starting with the U or D one, or the F or B one for slice edges.
+        static constexpr uint8_t EdgeFacelet[12][2] = {
+                {5,  10}, {7,  19}, {3,  37}, {1,  46}, {32, 16}, {28, 25},
+                {30, 43}, {34, 52}, {23, 12}, {21, 41}, {50, 39}, {48, 14}};
+        static constexpr Face ConorColor[8][3] = {
+                {FaceU, FaceR, FaceF}, {FaceU, FaceF, FaceL}, {FaceU, FaceL, FaceB}, {FaceU, FaceB, FaceR},
+                {FaceD, FaceF, FaceR}, {FaceD, FaceL, FaceF}, {FaceD, FaceB, FaceL}, {FaceD, FaceR, FaceB}};
+        static constexpr Face EdgeColor[12][2] = {
+                {FaceU, FaceR}, {FaceU, FaceF}, {FaceU, FaceL}, {FaceU, FaceB}, {FaceD, FaceR}, {FaceD, FaceF},
+                {FaceD, FaceL}, {FaceD, FaceB}, {FaceF, FaceR}, {FaceF, FaceL}, {FaceB, FaceL}, {FaceB, FaceR}};
+
+        struct Lookup {
+            // Face of each letter, NoFace for other characters.
+            std::array<Face, 256> faceOf_{};
+            // Corner with the two colors clockwise after its U or D color, or -1.
+            int8_t conorOf_[6][6] = {};
+            // 2 * edge + flip for the colors read in facelet order, or -1.
+            int8_t edgeOf_[6][6] = {};
+
+            constexpr Lookup();
+        };
+
+        static const Lookup Tables;
+
+        [[noreturn]] static void reject(const char *what);
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    constexpr Facelets::Lookup::Lookup() {
+        faceOf_.fill(NoFace);
+        for (int f = 0; f < 6; ++f) {
+            faceOf_[static_cast<uint8_t>(FaceName[f])] = static_cast<Face>(f);
+        }
+        for (auto &row : conorOf_) {
+            for (auto &x : row) {
+                x = -1;
+            }
+        }
+        for (auto &row : edgeOf_) {
+            for (auto &x : row) {
+                x = -1;
+            }
+        }
+        for (int i = 0; i < 8; ++i) {
+            conorOf_[ConorColor[i][1]][ConorColor[i][2]] = static_cast<int8_t>(i);
+        }
+        for (int i = 0; i < 12; ++i) {
+            edgeOf_[EdgeColor[i][0]][EdgeColor[i][1]] = static_cast<int8_t>(2 * i);
+            edgeOf_[EdgeColor[i][1]][EdgeColor[i][0]] = static_cast<int8_t>(2 * i + 1);
+        }
+    }
+
+    inline constexpr Facelets::Lookup Facelets::Tables{};
+
+    void Facelets::reject(const char *what) {
+        throw std::invalid_argument(std::string("Facelets::parse: ") + what);
+    }
+
+    CubeStatus Facelets::parse(std::string_view facelets) {
+        if (facelets.size() != FaceletCnt) {
+            reject("expected 54 facelets");
+        }
+        Face face[FaceletCnt];
+        int count[6] = {};
+        for (int i = 0; i < FaceletCnt; ++i) {
+            face[i] = Tables.faceOf_[static_cast<uint8_t>(facelets[i])];
+            if (face[i] == NoFace) {
+                reject("unknown face letter");
+            }
+            count[face[i]] += 1;
+        }
+        for (int f = 0; f < 6; ++f) {
+            if (count[f] != 9 || face[9 * f + 4] != f) {
+                reject("wrong center or color count");
+            }
+        }
+
+        CubeStatus res;
+        uint32_t seen = 0;
+        int twist = 0, flip = 0;
+        for (int i = 0; i < 8; ++i) {
+            int ori = 0;
+            while (ori < 3 && face[ConorFacelet[i][ori]] != FaceU && face[ConorFacelet[i][ori]] != FaceD) {
+                ori += 1;
+            }
+            if (ori == 3) {
+                reject("corner without U or D color");
+            }
+            int8_t c = Tables.conorOf_[face[ConorFacelet[i][(ori + 1) % 3]]][face[ConorFacelet[i][(ori + 2) % 3]]];
+            if (c < 0 || ConorColor[c][0] != face[ConorFacelet[i][ori]]) {
+                reject("unknown corner");
+            }
+            seen |= 1u << c;
+            twist += ori;
+            res.move_[i] = MoveResult(c, static_cast<int8_t>(ori));
+        }
+        for (int i = 0; i < 12; ++i) {
+            int8_t e = Tables.edgeOf_[face[EdgeFacelet[i][0]]][face[EdgeFacelet[i][1]]];
+            if (e < 0) {
+                reject("unknown edge");
+            }
+            seen |= 1u << (BlockPos::UR + e / 2);
+            flip += e & 1;
+            res.move_[BlockPos::UR + i] = MoveResult(BlockPos::UR + e / 2, static_cast<int8_t>(e & 1));
+        }
+        if (seen != (1u << (BlockPos::BR + 1)) - 1) {
+            reject("repeated corner or edge");
+        }
+        if (twist % 3 != 0 || flip % 2 != 0) {
+            reject("twisted corner or flipped edge");
+        }
+        // Both permutations must have the same parity, which is that of their inversion counts.
+        int inversions = 0;
+        for (int i = BlockPos::URF; i <= BlockPos::DRB; ++i) {
+            for (int j = i + 1; j <= BlockPos::DRB; ++j) {
+                inversions += res.move_[i].pos() > res.move_[j].pos();
+            }
+        }
+        for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
+            for (int j = i + 1; j <= BlockPos::BR; ++j) {
+                inversions += res.move_[i].pos() > res.move_[j].pos();
+            }
+        }
+        if (inversions % 2 != 0) {
+            reject("odd permutation");
+        }
+        return res;
+    }
+
+    void Facelets::serialize(const CubeStatus &c, char *out) {
+        for (int f = 0; f < 6; ++f) {
+            out[9 * f + 4] = FaceName[f];
+        }
+        for (int i = 0; i < 8; ++i) {
+            int j = c.move_[i].pos(), ori = c.move_[i].ori();
+            for (int n = 0; n < 3; ++n) {
+                out[ConorFacelet[i][(n + ori) % 3]] = FaceName[ConorColor[j][n]];
+            }
+        }
+        for (int i = 0; i < 12; ++i) {
+            int j = c.move_[BlockPos::UR + i].pos() - BlockPos::UR, ori = c.move_[BlockPos::UR + i].ori();
+            for (int n = 0; n < 2; ++n) {
+                out[EdgeFacelet[i][(n + ori) % 2]] = FaceName[EdgeColor[j][n]];
+            }
+        }
+    }
+
+    std::string Facelets::toString(const CubeStatus &c) {
+        std::string res(FaceletCnt, ' ');
+        serialize(c, res.data());
+        return res;
+    }
+}
+
+#endif //CUBE_SOLVER_FACELET_H
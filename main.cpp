@@ -1,6 +1,136 @@
 #include <iostream>
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <limits>
 
-int main() {
-    std::cout << "Hello World" << std::endl;
-    return 0;
-}
\ No newline at end of file
+#include <csignal>
+
+#include "stream_solver.h"
+#include "solve_server.h"
+
+using namespace Cube;
+
+static void usage() {
+    std::cerr << "usage: cube_solver [--threads N] [--max-length N] [--cache N] [--tables PATH]\n"
+                 "                   [--numa interleave|replicate] [FILE]\n"
+                 "       cube_solver [--threads N] [--max-length N] [--cache N] [--tables PATH]\n"
+                 "                   [--numa interleave|replicate] (--serve-unix PATH | --serve-tcp PORT)\n"
+                 "Reads scrambles or facelet strings, one per line, from FILE or stdin, and writes one\n"
+                 "solution per line in input order. With --serve-*, answers such lines on a socket until\n"
+                 "interrupted. --threads N solves on exactly N threads, by default on all cores.\n"
+                 "--cache N remembers the solutions of N cubes up to symmetry and inversion.\n"
+                 "--numa spreads the tables over the NUMA nodes, or copies them to each node and pins the\n"
+                 "threads to the nodes.\n";
+}
+
+// Parse value as a decimal integer in [min, max], returning false on anything else.
+static bool parseInt(const std::string &value, long min, long max, long &out) {
+    char *end = nullptr;
+    errno = 0;
+    long res = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno == ERANGE || res < min || res > max) {
+        return false;
+    }
+    out = res;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Threads solving, 0 for the default pool.
+    long threads = 0;
+    std::string tablePath = "cube_solver_tables.bin";
+    std::string inputPath = "-";
+    std::string serveUnix;
+    int serveTcp = -1;
+    StreamSolver::Options options;
+    auto numa = TwoPhaseSolver::NumaPolicy::Shared;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--threads" || arg == "--max-length" || arg == "--cache" || arg == "--tables" ||
+             arg == "--serve-unix" || arg == "--serve-tcp" || arg == "--numa") && i + 1 < argc) {
+            std::string value = argv[++i];
+            long number = 0;
+            bool valid = true;
+            if (arg == "--numa") {
+                if (value != "interleave" && value != "replicate") {
+                    usage();
+                    return 2;
+                }
+                numa = value == "interleave" ? TwoPhaseSolver::NumaPolicy::Interleave
+                                             : TwoPhaseSolver::NumaPolicy::Replicate;
+            } else if (arg == "--serve-unix") {
+                serveUnix = value;
+            } else if (arg == "--serve-tcp") {
+                valid = parseInt(value, 0, 65535, number);
+                serveTcp = static_cast<int>(number);
+            } else if (arg == "--threads") {
+                valid = parseInt(value, 1, 4096, threads);
+            } else if (arg == "--cache") {
+                valid = parseInt(value, 0, std::numeric_limits<long>::max(), number);
+                options.cacheCapacity_ = static_cast<size_t>(number);
+            } else if (arg == "--max-length") {
+                valid = parseInt(value, 0, TwoPhaseSolver::MaxPhaseOneDepth + TwoPhaseSolver::MaxPhaseTwoDepth,
+                                 number);
+                options.maxLength_ = static_cast<int>(number);
+            } else {
+                tablePath = value;
+            }
+            if (!valid) {
+                std::cerr << "invalid value for " << arg << ": " << value << "\n";
+                usage();
+                return 2;
+            }
+        } else if (arg == "-h" || arg == "--help" || (arg.size() > 1 && arg[0] == '-')) {
+            usage();
+            return arg[1] == 'h' || arg == "--help" ? 0 : 2;
+        } else {
+            inputPath = arg;
+        }
+    }
+
+    std::ios::sync_with_stdio(false);
+    // Blocked before any thread starts, so that only the sigwait below receives them.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    bool serve = !serveUnix.empty() || serveTcp >= 0;
+    if (serve) {
+        pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    }
+    try {
+        TwoPhaseSolver solver(tablePath);
+        solver.placeTables(numa);
+        // The calling thread solves as well, so N threads take N - 1 workers.
+        ThreadPool pool(threads == 0 ? ThreadPool::HardwareThreads : static_cast<unsigned>(threads - 1),
+                        numa == TwoPhaseSolver::NumaPolicy::Replicate);
+        if (serve) {
+            SolveServer::Options serverOptions;
+            serverOptions.maxLength_ = options.maxLength_;
+            serverOptions.cacheCapacity_ = options.cacheCapacity_;
+            SolveServer server(solver, pool, serverOptions);
+            if (!serveUnix.empty()) {
+                server.listenUnix(serveUnix);
+                std::cerr << "serving on " << serveUnix << std::endl;
+            } else {
+                std::cerr << "serving on 127.0.0.1:" << server.listenTcp(static_cast<uint16_t>(serveTcp)) << std::endl;
+            }
+            int signal = 0;
+            sigwait(&stopSignals, &signal);
+            server.stop();
+            std::cerr << server.answered() << " requests answered" << std::endl;
+            return 0;
+        }
+        auto in = inputPath == "-" ? std::make_unique<LineReader>(std::cin) : std::make_unique<LineReader>(inputPath);
+        auto summary = StreamSolver(solver, pool, options).run(*in, std::cout);
+        std::cerr << summary.lines_ << " lines, " << summary.errors_ << " errors, " << summary.seconds_ << " s, "
+                  << static_cast<double>(summary.lines_) / summary.seconds_ << " lines/s" << std::endl;
+        return summary.errors_ == 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef CUBE_SOLVER_NOTATION_H
+#define CUBE_SOLVER_NOTATION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+
+#include "utility.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Move sequences in Singmaster notation: a face letter of URFDLB followed by nothing for a clockwise
+     * quarter turn, 2 for a half turn and ' (or 3) for a counterclockwise quarter turn. Moves may be
+     * separated by white space, as in "R U R' U2".
+     * */
+    class Notation {
+    public:
+        Notation() = delete;
+
+        // Append the moves of text to out. Throws std::invalid_argument on anything else.
+        static void parseMoves(std::string_view text, std::vector<MoveName> &out);
+
+        // Append the moves separated by single spaces to out.
+        static void appendMoves(const MoveName *moves, int length, std::string &out);
+
+        static std::string toString(const std::vector<MoveName> &moves);
+
+    protected:
+        static constexpr char FaceName[6] = {'U', 'D', 'F', 'B', 'L', 'R'};
+        static constexpr char PowerName[3] = {'\0', '2', '\''};
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    void Notation::parseMoves(std::string_view text, std::vector<MoveName> &out) {
+        size_t i = 0;
+        while (i < text.size()) {
+            char ch = text[i++];
+            if (ch == ' ' || ch == '\t') {
+                continue;
+            }
+            int face = 0;
+            while (face < 6 && FaceName[face] != ch) {
+                face += 1;
+            }
+            if (face == 6) {
+                throw std::invalid_argument(std::string(__func__) + ": unknown move '" + ch + "'");
+            }
+            int power = 0;
+            if (i < text.size()) {
+                if (text[i] == '2') {
+                    power = 1;
+                } else if (text[i] == '\'' || text[i] == '3') {
+                    power = 2;
+                }
+                i += power != 0;
+            }
+            out.push_back(static_cast<MoveName>(3 * face + power));
+        }
+    }
+
+    void Notation::appendMoves(const MoveName *moves, int length, std::string &out) {
+        for (int i = 0; i < length; ++i) {
+            if (i != 0) {
+                out.push_back(' ');
+            }
+            out.push_back(FaceName[moves[i] / 3]);
+            if (moves[i] % 3 != 0) {
+                out.push_back(PowerName[moves[i] % 3]);
+            }
+        }
+    }
+
+    std::string Notation::toString(const std::vector<MoveName> &moves) {
+        std::string res;
+        appendMoves(moves.data(), static_cast<int>(moves.size()), res);
+        return res;
+    }
+}
+
+#endif //CUBE_SOLVER_NOTATION_H
@@ -0,0 +1,183 @@
+#ifndef CUBE_SOLVER_NUMA_H
+#define CUBE_SOLVER_NUMA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * NUMA nodes of the host and their CPUs, as listed in sysfs. Nodes without CPUs are left out, and a host
+     * whose nodes are not listed has a single node with all CPUs.
+     *
+     * Memory is placed by the mbind system call, so that no NUMA library is needed. Placement and pinning
+     * are hints: where the kernel refuses them, pages and threads stay where they would be otherwise.
+     * */
+    class NumaTopology {
+    public:
+        // Node of placeMemory which spreads the pages over all nodes.
+        static constexpr int AllNodes = -1;
+
+        NumaTopology(const NumaTopology &) = delete;
+
+        void operator=(const NumaTopology &) = delete;
+
+        static const NumaTopology &get();
+
+        int nodeCnt() const;
+
+        const std::vector<int> &cpus(int node) const;
+
+        // The node the calling thread is pinned to by pinThread, else the node of the CPU it runs on.
+        int currentNode() const;
+
+        // Pin the calling thread to the CPUs of node, returning whether the kernel allowed it.
+        bool pinThread(int node) const;
+
+        // Place the pages of [p, p + length) on node, or interleave them over all nodes for AllNodes. p must be
+        // page aligned, and only pages touched afterwards follow the placement. Returns whether the kernel
+        // accepted it.
+        bool placeMemory(void *p, uint64_t length, int node) const;
+
+    protected:
+        NumaTopology();
+
+        // CPUs or nodes of a sysfs list such as "0-3,8-11".
+        static std::vector<int> parseList(const std::string &list);
+
+        static std::string readLine(const std::string &path);
+
+        // Kernel node id and CPUs by node.
+        std::vector<int> nodeId_;
+        std::vector<std::vector<int>> cpus_;
+        // Node by CPU, -1 for CPUs of no node.
+        std::vector<int> nodeOfCpu_;
+
+        static thread_local int pinnedNode_;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    inline thread_local int NumaTopology::pinnedNode_ = -1;
+
+    const NumaTopology &NumaTopology::get() {
+        static NumaTopology topology;
+        return topology;
+    }
+
+    NumaTopology::NumaTopology() {
+        const std::string base = "/sys/devices/system/node/";
+        for (int id : parseList(readLine(base + "online"))) {
+            auto cpus = parseList(readLine(base + "node" + std::to_string(id) + "/cpulist"));
+            if (!cpus.empty()) {
+                nodeId_.push_back(id);
+                cpus_.push_back(std::move(cpus));
+            }
+        }
+        if (cpus_.empty()) {
+            nodeId_ = {0};
+            cpus_.emplace_back();
+            for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF); ++cpu) {
+                cpus_[0].push_back(static_cast<int>(cpu));
+            }
+        }
+        for (int node = 0; node < nodeCnt(); ++node) {
+            for (int cpu : cpus_[node]) {
+                if (cpu >= static_cast<int>(nodeOfCpu_.size())) {
+                    nodeOfCpu_.resize(cpu + 1, -1);
+                }
+                nodeOfCpu_[cpu] = node;
+            }
+        }
+    }
+
+    std::vector<int> NumaTopology::parseList(const std::string &list) {
+        std::vector<int> res;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            end = end == std::string::npos ? list.size() : end;
+            auto range = list.substr(pos, end - pos);
+            auto dash = range.find('-');
+            try {
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int i = first; i <= last; ++i) {
+                    res.push_back(i);
+                }
+            } catch (const std::exception &) {
+                return {};
+            }
+            pos = end + 1;
+        }
+        return res;
+    }
+
+    std::string NumaTopology::readLine(const std::string &path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    int NumaTopology::nodeCnt() const {
+        return static_cast<int>(cpus_.size());
+    }
+
+    const std::vector<int> &NumaTopology::cpus(int node) const {
+        return cpus_[node];
+    }
+
+    int NumaTopology::currentNode() const {
+        if (pinnedNode_ >= 0) {
+            return pinnedNode_;
+        }
+        int cpu = sched_getcpu();
+        if (cpu < 0 || cpu >= static_cast<int>(nodeOfCpu_.size()) || nodeOfCpu_[cpu] < 0) {
+            return 0;
+        }
+        return nodeOfCpu_[cpu];
+    }
+
+    bool NumaTopology::pinThread(int node) const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus_[node]) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            return false;
+        }
+        pinnedNode_ = node;
+        return true;
+    }
+
+    bool NumaTopology::placeMemory(void *p, uint64_t length, int node) const {
+        constexpr int WordBits = 8 * sizeof(unsigned long);
+        int maxId = *std::max_element(nodeId_.begin(), nodeId_.end());
+        std::vector<unsigned long> mask(maxId / WordBits + 1, 0);
+        for (int i = 0; i < nodeCnt(); ++i) {
+            if (node == AllNodes || node == i) {
+                mask[nodeId_[i] / WordBits] |= 1UL << nodeId_[i] % WordBits;
+            }
+        }
+        // A preferred node rather than a bound one, so that a full node does not fail the allocation.
+        int mode = node == AllNodes ? MPOL_INTERLEAVE : MPOL_PREFERRED;
+        return syscall(SYS_mbind, p, length, mode, mask.data(), mask.size() * WordBits + 1, 0) == 0;
+    }
+}
+
+#endif //CUBE_SOLVER_NUMA_H
@@ -0,0 +1,371 @@
+#ifndef CUBE_SOLVER_OPTIMAL_SOLVER_H
+#define CUBE_SOLVER_OPTIMAL_SOLVER_H
+
+#include <cstdint>
+#include <bit>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+#include "cube_def.h"
+#include "utility.h"
+#include "pruning_table.h"
+#include "table_file.h"
+#include "thread_pool.h"
+#include "search_stats.h"
+#include "two_phase_solver.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Finds shortest solutions by IDA* over all 18 face turns.
+     *
+     * The heuristic is the largest of four lower bounds: the distance of the corners alone, from a pattern
+     * database over conor permutation x twist reduced by the 16 symmetries keeping the UD axis, and the
+     * phase one distance of TwoPhaseSolver of the cube seen with each of the three axes as U/D, since a
+     * solved cube is in all three subgroups.
+     *
+     * The corner tables live in a table file of their own, mapped like those of TwoPhaseSolver. The move
+     * and phase one tables are those of the TwoPhaseSolver given, which must outlive this solver. With
+     * NumaPolicy::Replicate they are read from the replica of the searching thread's node, while the corner
+     * tables are not replicated. The search loads the table entries of all children of a node before it
+     * looks at the first of them, so that their cache misses overlap.
+     * */
+    class OptimalSolver {
+    public:
+        // Every cube can be solved within 20 moves.
+        static constexpr int MaxDepth = 20;
+
+        // Build the corner tables in memory.
+        explicit OptimalSolver(const TwoPhaseSolver &twoPhase);
+
+        // Map the corner tables from the table file at tablePath, building and writing it if it is missing or
+        // stale.
+        OptimalSolver(const TwoPhaseSolver &twoPhase, const std::string &tablePath);
+
+        bool tablesMapped() const;
+
+        struct SolveResult {
+            std::vector<MoveName> solution_;
+            // Nodes by depth, cutoffs and time of the search.
+            PhaseStats stats_;
+        };
+
+        // A shortest solution of start. If it is longer than maxDepth, the solution is empty, as it is for
+        // the solved cube.
+        SolveResult solve(const CubeStatus &start, int maxDepth = MaxDepth) const;
+
+    protected:
+        static constexpr int TwistCnt = TwoPhaseSolver::TwistCnt;
+        static constexpr int ConorPermCnt = TwoPhaseSolver::ConorPermCnt;
+        static constexpr int MoveCnt = TwoPhaseSolver::MoveCnt;
+        static constexpr int SymCnt = TwoPhaseSolver::SymCnt;
+        static constexpr int ConorPermClassCnt = 2768;
+        static constexpr int AxisCnt = 3;
+
+        const TwoPhaseSolver &twoPhase_;
+        TableStorage tables_;
+
+        // Conor permutation symmetry classes, like the flipslice classes of TwoPhaseSolver.
+        uint16_t *ConorPermClassIdx_ = nullptr;
+        uint8_t *ConorPermSym_ = nullptr;
+        uint16_t *ConorPermRep_ = nullptr;
+        uint16_t *ConorPermSelfSym_ = nullptr;
+        // Indexed by conor permutation class * TwistCnt + twist conjugated into the class.
+        PruningTable ConorHeuristic_;
+        FRIEND_TEST(CubeTest, OptimalSolver);
+
+        // axisMove_[a][m] is the move m as seen on MoveFactory::conjugate(c, 16 * a), which has the a-th
+        // axis as U/D.
+        MoveName axisMove_[AxisCnt][MoveCnt];
+
+        // A position of the search with the exact distances of its heuristics.
+        struct Node {
+            uint16_t conorPerm_;
+            uint16_t twist_[AxisCnt], flip_[AxisCnt], slice_[AxisCnt];
+            uint64_t conorIdx_;
+            uint64_t axisIdx_[AxisCnt];
+            uint32_t conorDepth_;
+            uint32_t axisDepth_[AxisCnt];
+        };
+
+        void initAxisMoves();
+
+        // See TwoPhaseSolver::forEachTable.
+        template<typename Visit>
+        void forEachTable(Visit visit);
+
+        std::vector<uint64_t> tableLayout();
+
+        void bindTables();
+
+        void buildTables();
+
+        void buildConorPermSymTable();
+
+        void buildConorHeuristic(ThreadPool &pool);
+
+        // The lookups below take the TwoPhaseSolver whose tables they read, the replica of the calling
+        // thread's node during a search, see TwoPhaseSolver::local.
+        inline uint64_t conorIndex(const TwoPhaseSolver &twoPhase, uint16_t conorPerm, uint16_t twist) const;
+
+        template<typename Visit>
+        void conorNeighbours(const TwoPhaseSolver &twoPhase, uint64_t idx, Visit &&visit) const;
+
+        template<typename Visit>
+        void conorEquivalents(uint64_t idx, Visit &&visit) const;
+
+        Node rootOf(const TwoPhaseSolver &twoPhase, const CubeStatus &start) const;
+
+        static uint32_t heuristic(const Node &node);
+
+        // Depth first search for solutions of exactly togo more moves, written to path.
+        bool dfs(const TwoPhaseSolver &twoPhase, const CubeStatus &start, const Node &node, int n, int togo,
+                 MoveName *path, PhaseStats &stats) const;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    template<typename Visit>
+    void OptimalSolver::forEachTable(Visit visit) {
+        visit(ConorPermClassIdx_, ConorPermCnt);
+        visit(ConorPermSym_, ConorPermCnt);
+        visit(ConorPermRep_, ConorPermClassCnt);
+        visit(ConorPermSelfSym_, ConorPermClassCnt);
+        visit(ConorHeuristic_, static_cast<uint64_t>(ConorPermClassCnt) * TwistCnt);
+    }
+
+    std::vector<uint64_t> OptimalSolver::tableLayout() {
+        std::vector<uint64_t> sectionSize;
+        forEachTable([&sectionSize](auto &table, uint64_t cnt) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(table)>, PruningTable>) {
+                sectionSize.push_back(PruningTable::byteSize(cnt));
+            } else {
+                sectionSize.push_back(cnt * sizeof(*table));
+            }
+        });
+        return sectionSize;
+    }
+
+    void OptimalSolver::bindTables() {
+        uint32_t i = 0;
+        forEachTable([this, &i](auto &table, uint64_t cnt) {
+            using Table = std::decay_t<decltype(table)>;
+            if constexpr (std::is_same_v<Table, PruningTable>) {
+                table = PruningTable(reinterpret_cast<uint64_t *>(tables_.section(i)), cnt);
+            } else {
+                table = reinterpret_cast<Table>(tables_.section(i));
+            }
+            i += 1;
+        });
+    }
+
+    void OptimalSolver::buildTables() {
+        ThreadPool pool;
+        buildConorPermSymTable();
+        buildConorHeuristic(pool);
+    }
+
+    void OptimalSolver::buildConorPermSymTable() {
+        constexpr uint16_t invalid = std::numeric_limits<uint16_t>::max();
+        std::fill(ConorPermClassIdx_, ConorPermClassIdx_ + ConorPermCnt, invalid);
+        std::fill(ConorPermSym_, ConorPermSym_ + ConorPermCnt, 0);
+        uint16_t classIdx = 0;
+        for (uint32_t conorPerm = 0; conorPerm < ConorPermCnt; ++conorPerm) {
+            if (ConorPermClassIdx_[conorPerm] != invalid) {
+                continue;
+            }
+            if (classIdx == ConorPermClassCnt) {
+                throw std::runtime_error(std::string(__func__) + ": more conor permutation classes than expected");
+            }
+            auto rep = MoveFactory::getByConorPermCoord(conorPerm);
+            uint16_t selfSym = 0;
+            for (int s = 0; s < SymCnt; ++s) {
+                auto other = static_cast<uint32_t>(
+                        MoveFactory::conjugate(rep, MoveFactory::SymInv_[s]).getConorPermCoord());
+                if (other == conorPerm) {
+                    selfSym |= 1 << s;
+                }
+                if (ConorPermClassIdx_[other] == invalid) {
+                    ConorPermClassIdx_[other] = classIdx;
+                    ConorPermSym_[other] = s;
+                }
+            }
+            ConorPermRep_[classIdx] = static_cast<uint16_t>(conorPerm);
+            ConorPermSelfSym_[classIdx] = selfSym;
+            classIdx += 1;
+        }
+    }
+
+    void OptimalSolver::buildConorHeuristic(ThreadPool &pool) {
+        ConorHeuristic_.build(
+                pool, [this](uint64_t idx, auto &&visit) { conorNeighbours(twoPhase_, idx, visit); },
+                [this](uint64_t idx, auto &&visit) { conorEquivalents(idx, visit); });
+    }
+
+    uint64_t OptimalSolver::conorIndex(const TwoPhaseSolver &twoPhase, uint16_t conorPerm, uint16_t twist) const {
+        return static_cast<uint64_t>(ConorPermClassIdx_[conorPerm]) * TwistCnt +
+               twoPhase.TwistConj_[twist][ConorPermSym_[conorPerm]];
+    }
+
+    template<typename Visit>
+    void OptimalSolver::conorNeighbours(const TwoPhaseSolver &twoPhase, uint64_t idx, Visit &&visit) const {
+        uint16_t conorPerm = ConorPermRep_[idx / TwistCnt];
+        auto twist = static_cast<uint16_t>(idx % TwistCnt);
+        for (int m = 0; m < MoveCnt; ++m) {
+            if (visit(conorIndex(twoPhase, twoPhase.ConorPermFullMoveTable_[conorPerm][m],
+                                 twoPhase.TwistMoveTable_[twist][m]))) {
+                return;
+            }
+        }
+    }
+
+    template<typename Visit>
+    void OptimalSolver::conorEquivalents(uint64_t idx, Visit &&visit) const {
+        uint64_t classIdx = idx / TwistCnt;
+        auto twist = static_cast<uint16_t>(idx % TwistCnt);
+        for (int s = 1, selfSym = ConorPermSelfSym_[classIdx] >> 1; selfSym != 0; ++s, selfSym >>= 1) {
+            if ((selfSym & 1) != 0 && visit(classIdx * TwistCnt + twoPhase_.TwistConj_[twist][s])) {
+                return;
+            }
+        }
+    }
+
+    OptimalSolver::Node OptimalSolver::rootOf(const TwoPhaseSolver &twoPhase, const CubeStatus &start) const {
+        Node node{};
+        for (int a = 0; a < AxisCnt; ++a) {
+            auto c = MoveFactory::conjugate(start, 16 * a);
+            node.twist_[a] = static_cast<uint16_t>(c.getConorOriCoord());
+            node.flip_[a] = static_cast<uint16_t>(c.getEdgeOriCoord());
+            node.slice_[a] = static_cast<uint16_t>(c.getUDSliceCoord());
+            node.axisIdx_[a] = twoPhase.phaseOneIndex(node.twist_[a], node.flip_[a], node.slice_[a]);
+            node.axisDepth_[a] = twoPhase.FlipSliceTwistHeuristic_.distance(
+                    node.axisIdx_[a],
+                    [&twoPhase](uint64_t idx, auto &&visit) { twoPhase.flipSliceTwistNeighbours(idx, visit); });
+        }
+        node.conorPerm_ = static_cast<uint16_t>(start.getConorPermCoord());
+        node.conorIdx_ = conorIndex(twoPhase, node.conorPerm_, node.twist_[0]);
+        node.conorDepth_ = ConorHeuristic_.distance(
+                node.conorIdx_,
+                [this, &twoPhase](uint64_t idx, auto &&visit) { conorNeighbours(twoPhase, idx, visit); });
+        return node;
+    }
+
+    uint32_t OptimalSolver::heuristic(const Node &node) {
+        return std::max({node.conorDepth_, node.axisDepth_[0], node.axisDepth_[1], node.axisDepth_[2]});
+    }
+
+    OptimalSolver::SolveResult OptimalSolver::solve(const CubeStatus &start, int maxDepth) const {
+        SolveResult res;
+        auto begin = std::chrono::steady_clock::now();
+        const auto &twoPhase = twoPhase_.local();
+        Node root = rootOf(twoPhase, start);
+        MoveName path[MaxDepth];
+        maxDepth = std::min(maxDepth, MaxDepth);
+        for (int depth = static_cast<int>(heuristic(root)); depth <= maxDepth; ++depth) {
+            if (dfs(twoPhase, start, root, 0, depth, path, res.stats_)) {
+                res.solution_.assign(path, path + depth);
+                break;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        res.stats_.seconds_ = elapsed.count();
+        return res;
+    }
+
+    bool OptimalSolver::dfs(const TwoPhaseSolver &twoPhase, const CubeStatus &start, const Node &node, int n,
+                            int togo, MoveName *path, PhaseStats &stats) const {
+        stats.nodes_[n] += 1;
+        if (togo == 0) {
+            // All heuristics are 0 here, which leaves only the edge permutation to check.
+            CubeStatus cur = start;
+            for (int i = 0; i < n; ++i) {
+                cur = MoveFactory::Moves_[path[i]] * cur;
+            }
+            return cur == MoveFactory::Id_;
+        }
+        uint32_t allowed = MoveFactory::NextMoves_[n > 0 ? path[n - 1] : MoveFactory::NoMove];
+
+        Node next[MoveCnt];
+        for (uint32_t rest = allowed; rest != 0; rest &= rest - 1) {
+            int m = std::countr_zero(rest);
+            auto &child = next[m];
+            for (int a = 0; a < AxisCnt; ++a) {
+                MoveName am = axisMove_[a][m];
+                child.twist_[a] = twoPhase.TwistMoveTable_[node.twist_[a]][am];
+                child.flip_[a] = twoPhase.FlipMoveTable_[node.flip_[a]][am];
+                child.slice_[a] = TwoPhaseSolver::UDSliceMoveTable_[node.slice_[a]][am];
+                child.axisIdx_[a] = twoPhase.phaseOneIndex(child.twist_[a], child.flip_[a], child.slice_[a]);
+                twoPhase.FlipSliceTwistHeuristic_.prefetch(child.axisIdx_[a]);
+            }
+            child.conorPerm_ = twoPhase.ConorPermFullMoveTable_[node.conorPerm_][m];
+            child.conorIdx_ = conorIndex(twoPhase, child.conorPerm_, child.twist_[0]);
+            ConorHeuristic_.prefetch(child.conorIdx_);
+        }
+
+        for (uint32_t rest = allowed; rest != 0; rest &= rest - 1) {
+            int m = std::countr_zero(rest);
+            auto &child = next[m];
+            child.conorDepth_ = PruningTable::nextDepth(node.conorDepth_, ConorHeuristic_.get(child.conorIdx_));
+            for (int a = 0; a < AxisCnt; ++a) {
+                child.axisDepth_[a] = PruningTable::nextDepth(
+                        node.axisDepth_[a], twoPhase.FlipSliceTwistHeuristic_.get(child.axisIdx_[a]));
+            }
+            stats.children_ += 1;
+            if (heuristic(child) >= static_cast<uint32_t>(togo)) {
+                stats.cutoffs_ += 1;
+                continue;
+            }
+            path[n] = static_cast<MoveName>(m);
+            if (dfs(twoPhase, start, child, n + 1, togo - 1, path, stats)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void OptimalSolver::initAxisMoves() {
+        for (int a = 0; a < AxisCnt; ++a) {
+            for (int m = 0; m < MoveCnt; ++m) {
+                axisMove_[a][m] = MoveFactory::conjugateMove(static_cast<MoveName>(m),
+                                                             MoveFactory::SymInv_[16 * a]);
+            }
+        }
+    }
+
+    OptimalSolver::OptimalSolver(const TwoPhaseSolver &twoPhase) : twoPhase_(twoPhase) {
+        initAxisMoves();
+        tables_ = TableStorage::allocate(tableLayout());
+        bindTables();
+        buildTables();
+    }
+
+    OptimalSolver::OptimalSolver(const TwoPhaseSolver &twoPhase, const std::string &tablePath)
+            : twoPhase_(twoPhase) {
+        initAxisMoves();
+        auto layout = tableLayout();
+        tables_ = TableStorage::map(tablePath, layout);
+        if (!tables_.empty()) {
+            bindTables();
+            return;
+        }
+        tables_ = TableStorage::allocate(layout);
+        bindTables();
+        buildTables();
+        tables_.save(tablePath);
+    }
+
+    bool OptimalSolver::tablesMapped() const {
+        return tables_.mapped();
+    }
+}
+
+#endif //CUBE_SOLVER_OPTIMAL_SOLVER_H
@@ -0,0 +1,222 @@
+#ifndef CUBE_SOLVER_PRUNING_TABLE_H
+#define CUBE_SOLVER_PRUNING_TABLE_H
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+
+#include "thread_pool.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Distance table packed into 2 bits per entry. Only the distance modulo 3 is stored: the distances
+     * of two neighbours differ by at most 1, so the exact distance of a neighbour can be recovered from
+     * the exact distance of the current entry. The exact distance of a single start entry is found by
+     * walking down to the goal, see distance().
+     *
+     * The goal is always index 0. Neighbours are given by a callable neighbours(idx, visit), which calls
+     * visit(next) for each neighbour of idx until visit returns true. The neighbour relation must be
+     * symmetric, which holds for move tables closed under inverses.
+     *
+     * The table does not own its memory, which is usually a section of a TableStorage.
+     *
+     * In symmetry reduced tables one position may be stored in several entries. equivalents(idx, visit)
+     * calls visit(other) for the other entries of the position at idx, so that they are filled together.
+     *
+     * The search is level synchronous: each level is one parallel sweep over the table, and entries are
+     * filled by compare-and-swap on their 64-bit word, so the callables must be safe to call concurrently.
+     * */
+    class PruningTable {
+    public:
+        static constexpr uint8_t Empty = 3;
+
+        PruningTable() = default;
+
+        PruningTable(uint64_t *data, uint64_t size);
+
+        uint64_t size() const;
+
+        // Bytes of memory needed for size entries.
+        static constexpr uint64_t byteSize(uint64_t size);
+
+        // Distance modulo 3, or Empty.
+        inline uint8_t get(uint64_t idx) const;
+
+        inline void set(uint64_t idx, uint8_t depth3);
+
+        // Start loading the word of idx, for a get() shortly after.
+        inline void prefetch(uint64_t idx) const;
+
+        // Exact distance of a neighbour of an entry at depth, given the neighbour's stored value.
+        static inline uint32_t nextDepth(uint32_t depth, uint8_t depth3);
+
+        // Breadth first search from index 0 over the whole table.
+        template<typename Neighbours>
+        void build(ThreadPool &pool, Neighbours neighbours);
+
+        template<typename Neighbours, typename Equivalents>
+        void build(ThreadPool &pool, Neighbours neighbours, Equivalents equivalents);
+
+        // Exact distance of idx to the goal.
+        template<typename Neighbours>
+        uint32_t distance(uint64_t idx, Neighbours neighbours) const;
+
+    protected:
+        // Entries handed to a thread at once during build.
+        static constexpr uint64_t BuildChunk = 1 << 16;
+
+        // get() and set() for use while other threads fill entries. fillIfEmpty returns whether this call
+        // filled the entry.
+        inline uint8_t load(uint64_t idx) const;
+
+        inline bool fillIfEmpty(uint64_t idx, uint8_t depth3);
+
+        // 32 entries per word.
+        uint64_t *data_ = nullptr;
+        uint64_t size_ = 0;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    PruningTable::PruningTable(uint64_t *data, uint64_t size) : data_(data), size_(size) {}
+
+    uint64_t PruningTable::size() const {
+        return size_;
+    }
+
+    constexpr uint64_t PruningTable::byteSize(uint64_t size) {
+        return (size + 31) / 32 * sizeof(uint64_t);
+    }
+
+    uint8_t PruningTable::get(uint64_t idx) const {
+        return static_cast<uint8_t>((data_[idx >> 5] >> ((idx & 31) << 1)) & 3);
+    }
+
+    void PruningTable::set(uint64_t idx, uint8_t depth3) {
+        uint64_t shift = (idx & 31) << 1;
+        data_[idx >> 5] = (data_[idx >> 5] & ~(3ULL << shift)) | (static_cast<uint64_t>(depth3) << shift);
+    }
+
+    void PruningTable::prefetch(uint64_t idx) const {
+        __builtin_prefetch(data_ + (idx >> 5));
+    }
+
+    uint8_t PruningTable::load(uint64_t idx) const {
+        uint64_t word = std::atomic_ref<uint64_t>(data_[idx >> 5]).load(std::memory_order_relaxed);
+        return static_cast<uint8_t>((word >> ((idx & 31) << 1)) & 3);
+    }
+
+    bool PruningTable::fillIfEmpty(uint64_t idx, uint8_t depth3) {
+        std::atomic_ref<uint64_t> word(data_[idx >> 5]);
+        uint64_t shift = (idx & 31) << 1;
+        uint64_t old = word.load(std::memory_order_relaxed);
+        do {
+            if (((old >> shift) & 3) != Empty) {
+                return false;
+            }
+            // Empty has both bits set, so only bits need to be cleared.
+        } while (!word.compare_exchange_weak(old, old & ~(static_cast<uint64_t>(Empty ^ depth3) << shift),
+                                             std::memory_order_relaxed));
+        return true;
+    }
+
+    uint32_t PruningTable::nextDepth(uint32_t depth, uint8_t depth3) {
+        switch ((depth3 + 3 - depth % 3) % 3) {
+            case 0:
+                return depth;
+            case 1:
+                return depth + 1;
+            default:
+                return depth - 1;
+        }
+    }
+
+    template<typename Neighbours>
+    void PruningTable::build(ThreadPool &pool, Neighbours neighbours) {
+        build(pool, neighbours, [](uint64_t, auto &&) {});
+    }
+
+    template<typename Neighbours, typename Equivalents>
+    void PruningTable::build(ThreadPool &pool, Neighbours neighbours, Equivalents equivalents) {
+        std::fill(data_, data_ + (size_ + 31) / 32, ~0ULL);
+        // Fill idx and its equivalent entries, returning how many were empty.
+        auto fill = [this, &equivalents](uint64_t idx, uint8_t depth3) {
+            uint64_t filled = 0;
+            if (fillIfEmpty(idx, depth3)) {
+                filled += 1;
+                equivalents(idx, [&](uint64_t other) {
+                    filled += fillIfEmpty(other, depth3);
+                    return false;
+                });
+            }
+            return filled;
+        };
+        uint64_t done = fill(0, 0);
+        for (uint32_t depth = 0; done < size_; ++depth) {
+            auto depth3 = static_cast<uint8_t>(depth % 3);
+            auto next3 = static_cast<uint8_t>((depth + 1) % 3);
+            // Once most entries are filled, looking for a filled neighbour of each empty entry is cheaper
+            // than expanding the frontier.
+            bool backSearch = done > size_ / 2;
+            std::atomic<uint64_t> levelDone{0};
+            pool.parallelFor(size_, BuildChunk, [&](uint64_t begin, uint64_t end) {
+                uint64_t filled = 0;
+                for (uint64_t idx = begin; idx < end; ++idx) {
+                    if (!backSearch) {
+                        // Entries at depth - 3, depth - 6, ... match as well, but have no empty neighbours.
+                        if (load(idx) != depth3) {
+                            continue;
+                        }
+                        neighbours(idx, [&](uint64_t next) {
+                            if (load(next) == Empty) {
+                                filled += fill(next, next3);
+                            }
+                            return false;
+                        });
+                    } else {
+                        if (load(idx) != Empty) {
+                            continue;
+                        }
+                        neighbours(idx, [&](uint64_t next) {
+                            // An empty entry is deeper than depth - 1, so this neighbour is exactly at depth.
+                            if (load(next) == depth3) {
+                                filled += fill(idx, next3);
+                                return true;
+                            }
+                            return false;
+                        });
+                    }
+                }
+                levelDone += filled;
+            });
+            done += levelDone;
+        }
+    }
+
+    template<typename Neighbours>
+    uint32_t PruningTable::distance(uint64_t idx, Neighbours neighbours) const {
+        uint32_t depth = 0;
+        while (idx != 0) {
+            auto prev3 = static_cast<uint8_t>((get(idx) + 2) % 3);
+            uint64_t cur = idx;
+            neighbours(cur, [&](uint64_t next) {
+                if (get(next) == prev3) {
+                    idx = next;
+                    return true;
+                }
+                return false;
+            });
+            depth += 1;
+        }
+        return depth;
+    }
+}
+
+#endif //CUBE_SOLVER_PRUNING_TABLE_H
@@ -0,0 +1,102 @@
+#ifndef CUBE_SOLVER_SEARCH_STATS_H
+#define CUBE_SOLVER_SEARCH_STATS_H
+
+#include <cstdint>
+#include <numeric>
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    // Work of one phase of a solve.
+    class PhaseStats {
+    public:
+        static constexpr int MaxDepth = 20;
+
+        // Nodes expanded, by their number of moves from the start of the phase.
+        uint64_t nodes_[MaxDepth + 1] = {};
+        // Children looked at, and those of them ruled out by the heuristic.
+        uint64_t children_ = 0;
+        uint64_t cutoffs_ = 0;
+        double seconds_ = 0;
+
+        uint64_t totalNodes() const;
+
+        double cutoffRate() const;
+
+        double nodesPerSecond() const;
+
+        PhaseStats &operator+=(const PhaseStats &other);
+    };
+
+    /*
+     * Counters filled by the searches of TwoPhaseSolver. The searches take the counters as a template
+     * parameter and only touch them if Enabled, so NoSearchStats compiles them out. Counters which are
+     * Budgeted also stop the searches once their budget is spent, see TwoPhaseSolver::BudgetedStats.
+     * */
+    class SearchStats {
+    public:
+        static constexpr bool Enabled = true;
+        static constexpr bool Budgeted = false;
+
+        PhaseStats phaseOne_;
+        PhaseStats phaseTwo_;
+        // Phase one solutions reached, and phase two searches started from them. Solutions ending with a
+        // G1 move are not searched further.
+        uint64_t phaseOneSolutions_ = 0;
+        uint64_t phaseTwoSearches_ = 0;
+
+        double phaseTwoSearchesPerSolution() const;
+
+        SearchStats &operator+=(const SearchStats &other);
+    };
+
+    class NoSearchStats {
+    public:
+        static constexpr bool Enabled = false;
+        static constexpr bool Budgeted = false;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    uint64_t PhaseStats::totalNodes() const {
+        return std::accumulate(nodes_, nodes_ + MaxDepth + 1, uint64_t(0));
+    }
+
+    double PhaseStats::cutoffRate() const {
+        return children_ == 0 ? 0 : static_cast<double>(cutoffs_) / static_cast<double>(children_);
+    }
+
+    double PhaseStats::nodesPerSecond() const {
+        return seconds_ == 0 ? 0 : static_cast<double>(totalNodes()) / seconds_;
+    }
+
+    PhaseStats &PhaseStats::operator+=(const PhaseStats &other) {
+        for (int i = 0; i <= MaxDepth; ++i) {
+            nodes_[i] += other.nodes_[i];
+        }
+        children_ += other.children_;
+        cutoffs_ += other.cutoffs_;
+        seconds_ += other.seconds_;
+        return *this;
+    }
+
+    double SearchStats::phaseTwoSearchesPerSolution() const {
+        return phaseOneSolutions_ == 0 ? 0 : static_cast<double>(phaseTwoSearches_) /
+                                             static_cast<double>(phaseOneSolutions_);
+    }
+
+    SearchStats &SearchStats::operator+=(const SearchStats &other) {
+        phaseOne_ += other.phaseOne_;
+        phaseTwo_ += other.phaseTwo_;
+        phaseOneSolutions_ += other.phaseOneSolutions_;
+        phaseTwoSearches_ += other.phaseTwoSearches_;
+        return *this;
+    }
+}
+
+#endif //CUBE_SOLVER_SEARCH_STATS_H
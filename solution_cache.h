@@ -0,0 +1,254 @@
+#ifndef CUBE_SOLVER_SOLUTION_CACHE_H
+#define CUBE_SOLVER_SOLUTION_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "cube_def.h"
+#include "two_phase_solver.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    struct CubeHash {
+        size_t operator()(const CubeStatus &c) const;
+    };
+
+    /*
+     * Bounded cache of solutions, safe to use from many threads.
+     *
+     * Cubes which differ by a symmetry of MoveFactory::Sym_ or by inversion share an entry. The key is the
+     * smallest of the 96 cubes S^-1 * c * S and S^-1 * c^-1 * S, and a hit maps the stored solution of the
+     * key back to c: by conjugating every move with S, and for an inverse key by also reversing and
+     * inverting the moves.
+     *
+     * The entries are split into shards by hash, each behind its own lock and evicting by CLOCK: an entry
+     * found since the hand last passed it survives one more round.
+     * */
+    class SolutionCache {
+    public:
+        static constexpr int MaxLength = TwoPhaseSolver::MaxPhaseOneDepth + TwoPhaseSolver::MaxPhaseTwoDepth;
+
+        explicit SolutionCache(size_t capacity, unsigned shardCnt = 16);
+
+        SolutionCache(const SolutionCache &) = delete;
+
+        void operator=(const SolutionCache &) = delete;
+
+        // Write the cached solution of cube to solution and return true, or return false.
+        bool lookup(const CubeStatus &cube, std::vector<MoveName> &solution);
+
+        // Remember a solution of cube, of at most MaxLength moves, unless one at least as short is cached.
+        void insert(const CubeStatus &cube, const MoveName *solution, int length);
+
+        // The cached solution if it has at most maxLength moves, otherwise solver.solve() and remember it.
+        std::vector<MoveName> solve(const TwoPhaseSolver &solver, const CubeStatus &cube, int maxLength = 30);
+
+        uint64_t hits() const;
+
+        uint64_t misses() const;
+
+    protected:
+        struct Key {
+            CubeStatus cube_;
+            // The key is Sym_[sym_]^-1 * c * Sym_[sym_], with c^-1 in place of c if inverse_.
+            int sym_ = 0;
+            bool inverse_ = false;
+        };
+
+        struct Entry {
+            CubeStatus key_;
+            uint8_t length_ = 0;
+            bool referenced_ = false;
+            uint8_t moves_[MaxLength] = {};
+        };
+
+        struct alignas(64) Shard {
+            std::mutex mutex_;
+            std::unordered_map<CubeStatus, uint32_t, CubeHash> index_;
+            std::vector<Entry> slots_;
+            size_t hand_ = 0;
+        };
+
+        size_t shardCapacity_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<uint64_t> hits_{0};
+        std::atomic<uint64_t> misses_{0};
+        // moveConj_[s][m] is the move Sym_[s] * Moves_[m] * Sym_[s]^-1.
+        uint8_t moveConj_[48][18];
+
+        static Key canonical(const CubeStatus &cube);
+
+        Shard &shardOf(const CubeStatus &key);
+
+        // Map a solution of the key back to the cube it was made from.
+        void toCube(const Key &key, const uint8_t *moves, int length, std::vector<MoveName> &solution) const;
+
+        // Inverse of toCube.
+        void toKey(const Key &key, const MoveName *moves, int length, uint8_t *out) const;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    size_t CubeHash::operator()(const CubeStatus &c) const {
+        uint64_t word[4];
+        std::memcpy(word, c.move_, sizeof(word));
+        uint64_t h = 0;
+        for (auto w : word) {
+            h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 29;
+        }
+        return static_cast<size_t>(h);
+    }
+
+    SolutionCache::SolutionCache(size_t capacity, unsigned shardCnt) {
+        shardCnt = std::max(1u, shardCnt);
+        shardCapacity_ = std::max<size_t>(1, (capacity + shardCnt - 1) / shardCnt);
+        for (unsigned i = 0; i < shardCnt; ++i) {
+            shards_.push_back(std::make_unique<Shard>());
+            // Sized once, so that a full cache does not allocate.
+            shards_.back()->index_.reserve(shardCapacity_);
+            shards_.back()->slots_.reserve(shardCapacity_);
+        }
+        for (int s = 0; s < 48; ++s) {
+            for (int m = 0; m < 18; ++m) {
+                moveConj_[s][m] = static_cast<uint8_t>(MoveFactory::conjugateMove(static_cast<MoveName>(m), s));
+            }
+        }
+    }
+
+    SolutionCache::Key SolutionCache::canonical(const CubeStatus &cube) {
+        Key best{cube, 0, false};
+        auto inverse = cube.inverse();
+        for (int inv = 0; inv < 2; ++inv) {
+            for (int s = 0; s < 48; ++s) {
+                auto c = MoveFactory::conjugate(inv == 0 ? cube : inverse, s);
+                if (std::memcmp(c.move_, best.cube_.move_, sizeof(c.move_)) < 0) {
+                    best = Key{c, s, inv == 1};
+                }
+            }
+        }
+        return best;
+    }
+
+    SolutionCache::Shard &SolutionCache::shardOf(const CubeStatus &key) {
+        return *shards_[(CubeHash()(key) >> 32) % shards_.size()];
+    }
+
+    void SolutionCache::toCube(const Key &key, const uint8_t *moves, int length,
+                               std::vector<MoveName> &solution) const {
+        // A solution b of S^-1 * c * S gives S * b * S^-1 for c. For c^-1 in place of c, b is c^-1 itself.
+        solution.resize(length);
+        for (int i = 0; i < length; ++i) {
+            int m = key.inverse_ ? moves[length - 1 - i] : moves[i];
+            if (key.inverse_) {
+                m = m / 3 * 3 + 2 - m % 3;
+            }
+            solution[i] = static_cast<MoveName>(moveConj_[key.sym_][m]);
+        }
+    }
+
+    void SolutionCache::toKey(const Key &key, const MoveName *moves, int length, uint8_t *out) const {
+        int symInv = MoveFactory::SymInv_[key.sym_];
+        for (int i = 0; i < length; ++i) {
+            int m = key.inverse_ ? moves[length - 1 - i] : moves[i];
+            if (key.inverse_) {
+                m = m / 3 * 3 + 2 - m % 3;
+            }
+            out[i] = moveConj_[symInv][m];
+        }
+    }
+
+    bool SolutionCache::lookup(const CubeStatus &cube, std::vector<MoveName> &solution) {
+        auto key = canonical(cube);
+        auto &shard = shardOf(key.cube_);
+        uint8_t moves[MaxLength];
+        int length;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            auto it = shard.index_.find(key.cube_);
+            if (it == shard.index_.end()) {
+                misses_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            auto &entry = shard.slots_[it->second];
+            entry.referenced_ = true;
+            length = entry.length_;
+            std::memcpy(moves, entry.moves_, length);
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        toCube(key, moves, length, solution);
+        return true;
+    }
+
+    void SolutionCache::insert(const CubeStatus &cube, const MoveName *solution, int length) {
+        if (length > MaxLength) {
+            return;
+        }
+        auto key = canonical(cube);
+        Entry entry;
+        entry.key_ = key.cube_;
+        entry.length_ = static_cast<uint8_t>(length);
+        toKey(key, solution, length, entry.moves_);
+
+        auto &shard = shardOf(key.cube_);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto it = shard.index_.find(key.cube_);
+        if (it != shard.index_.end()) {
+            // Concurrent misses on variants of one cube race here, and the shortest solution wins.
+            auto &cached = shard.slots_[it->second];
+            if (length < cached.length_) {
+                entry.referenced_ = cached.referenced_;
+                cached = entry;
+            } else {
+                cached.referenced_ = true;
+            }
+            return;
+        }
+        if (shard.slots_.size() < shardCapacity_) {
+            shard.index_.emplace(key.cube_, static_cast<uint32_t>(shard.slots_.size()));
+            shard.slots_.push_back(entry);
+            return;
+        }
+        while (shard.slots_[shard.hand_].referenced_) {
+            shard.slots_[shard.hand_].referenced_ = false;
+            shard.hand_ = (shard.hand_ + 1) % shardCapacity_;
+        }
+        shard.index_.erase(shard.slots_[shard.hand_].key_);
+        shard.index_.emplace(key.cube_, static_cast<uint32_t>(shard.hand_));
+        shard.slots_[shard.hand_] = entry;
+        shard.hand_ = (shard.hand_ + 1) % shardCapacity_;
+    }
+
+    std::vector<MoveName> SolutionCache::solve(const TwoPhaseSolver &solver, const CubeStatus &cube, int maxLength) {
+        std::vector<MoveName> solution;
+        if (lookup(cube, solution) && static_cast<int>(solution.size()) <= maxLength) {
+            return solution;
+        }
+        solution = solver.solve(cube, maxLength);
+        if (!solution.empty() || cube == MoveFactory::Id_) {
+            insert(cube, solution.data(), static_cast<int>(solution.size()));
+        }
+        return solution;
+    }
+
+    uint64_t SolutionCache::hits() const {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t SolutionCache::misses() const {
+        return misses_.load(std::memory_order_relaxed);
+    }
+}
+
+#endif //CUBE_SOLVER_SOLUTION_CACHE_H
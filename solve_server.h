@@ -0,0 +1,494 @@
+#ifndef CUBE_SOLVER_SOLVE_SERVER_H
+#define CUBE_SOLVER_SOLVE_SERVER_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "cube_def.h"
+#include "notation.h"
+#include "thread_pool.h"
+#include "two_phase_solver.h"
+#include "stream_solver.h"
+#include "solution_cache.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Long running solver answering requests over a Unix domain socket or TCP on localhost, so that the
+     * tables are mapped once for all requests.
+     *
+     * Requests are lines as read by StreamSolver, and each connection gets its answers in request order.
+     * An answer is the solution followed by a tab and the stats of the request,
+     *
+     *     R U R' U'<tab>length=4 nodes=113 wait_us=12 solve_us=208 batch=3 cached=0
+     *
+     * or a line starting with "error: ". Answers taken from the SolutionCache, if enabled, have
+     * cached=1. An empty request gets an empty answer.
+     *
+     * A thread per connection reads requests into one bounded queue. A dispatcher takes whatever is
+     * queued, at most maxBatch_ requests, solves them with one parallelFor over the pool and hands the
+     * answers to a writing thread per connection. Under load requests are batched without waiting for a
+     * batch to fill, and an idle server answers a single request at once.
+     *
+     * A client which does not read its answers only holds up its own writer. Its connection is dropped
+     * once more than maxPendingBytes_ of answers wait for it, or a send blocks for sendTimeout_.
+     * */
+    class SolveServer {
+    public:
+        struct Options {
+            int maxLength_ = 30;
+            size_t maxBatch_ = 256;
+            // Requests queued before the connection threads stop reading.
+            size_t queueCapacity_ = 4096;
+            // Longest request line, longer ones close the connection.
+            size_t maxLineLength_ = 4096;
+            // Solutions remembered by a SolutionCache, none if 0.
+            size_t cacheCapacity_ = 0;
+            // Answers waiting for a client, beyond which its connection is dropped.
+            size_t maxPendingBytes_ = 1 << 20;
+            // Seconds a send may block before the connection is dropped.
+            double sendTimeout_ = 10;
+        };
+
+        SolveServer(const TwoPhaseSolver &solver, ThreadPool &pool, Options options);
+
+        SolveServer(const TwoPhaseSolver &solver, ThreadPool &pool);
+
+        SolveServer(const SolveServer &) = delete;
+
+        void operator=(const SolveServer &) = delete;
+
+        ~SolveServer();
+
+        // Serve on a Unix domain socket at path, replacing a stale socket file.
+        void listenUnix(const std::string &path);
+
+        // Serve on 127.0.0.1:port, or on a free port if port is 0. Returns the port.
+        uint16_t listenTcp(uint16_t port);
+
+        // Stop accepting, close all connections and wait for every thread of the server.
+        void stop();
+
+        uint64_t answered() const;
+
+    protected:
+        struct Connection {
+            int fd_;
+            // Answers not yet sent by the writer, and the requests read but not yet answered.
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::string outbox_;
+            size_t pending_ = 0;
+            bool reading_ = true;
+            // Once dropped, the answers still to come are discarded.
+            bool dropped_ = false;
+
+            explicit Connection(int fd) : fd_(fd) {}
+
+            ~Connection() {
+                ::close(fd_);
+            }
+        };
+
+        struct Request {
+            std::shared_ptr<Connection> connection_;
+            std::string line_;
+            std::chrono::steady_clock::time_point received_;
+            std::string answer_;
+        };
+
+        const TwoPhaseSolver &solver_;
+        ThreadPool &pool_;
+        Options options_;
+        BoundedQueue<Request> requests_;
+        std::unique_ptr<SolutionCache> cache_;
+
+        int listenFd_ = -1;
+        std::string unixPath_;
+        std::thread acceptor_;
+        std::thread dispatcher_;
+        std::atomic<bool> stopping_{false};
+        std::atomic<uint64_t> answered_{0};
+
+        // Open connections, and the number of their reading and writing threads still running.
+        std::mutex connectionMutex_;
+        std::condition_variable threadDone_;
+        std::vector<std::weak_ptr<Connection>> connections_;
+        unsigned readerCnt_ = 0;
+        unsigned writerCnt_ = 0;
+
+        void start(int listenFd);
+
+        void acceptLoop();
+
+        void readLoop(std::shared_ptr<Connection> connection);
+
+        void readRequests(const std::shared_ptr<Connection> &connection);
+
+        void writeLoop(std::shared_ptr<Connection> connection);
+
+        // Queue text for the writer of connection, dropping the connection if too much is queued.
+        void post(Connection &connection, const std::string &text, size_t answered);
+
+        // Run body on a detached thread counted by cnt.
+        template<typename Body>
+        void spawnCounted(unsigned &cnt, Body body);
+
+        // Shut the socket down, which ends both threads of the connection. Requires connection.mutex_.
+        static void drop(Connection &connection);
+
+        void dispatchLoop();
+
+        void answer(Request &request, std::chrono::steady_clock::time_point batchBegin, size_t batchSize) const;
+
+        static bool sendAll(int fd, const std::string &data);
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    SolveServer::SolveServer(const TwoPhaseSolver &solver, ThreadPool &pool, Options options)
+            : solver_(solver), pool_(pool), options_(options), requests_(options.queueCapacity_) {
+        if (options_.cacheCapacity_ != 0) {
+            cache_ = std::make_unique<SolutionCache>(options_.cacheCapacity_);
+        }
+    }
+
+    SolveServer::SolveServer(const TwoPhaseSolver &solver, ThreadPool &pool)
+            : SolveServer(solver, pool, Options()) {}
+
+    SolveServer::~SolveServer() {
+        stop();
+    }
+
+    void SolveServer::listenUnix(const std::string &path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error(std::string(__func__) + ": socket path too long");
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(fd, SOMAXCONN) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error(std::string(__func__) + ": cannot listen on " + path);
+        }
+        start(fd);
+        unixPath_ = path;
+    }
+
+    uint16_t SolveServer::listenTcp(uint16_t port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (fd < 0 || ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0 ||
+            ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error(std::string(__func__) + ": cannot listen on port " + std::to_string(port));
+        }
+        start(fd);
+        return ntohs(addr.sin_port);
+    }
+
+    void SolveServer::start(int listenFd) {
+        if (listenFd_ >= 0) {
+            ::close(listenFd);
+            throw std::runtime_error(std::string(__func__) + ": already serving");
+        }
+        listenFd_ = listenFd;
+        dispatcher_ = std::thread([this] { dispatchLoop(); });
+        acceptor_ = std::thread([this] { acceptLoop(); });
+    }
+
+    void SolveServer::stop() {
+        if (listenFd_ < 0 || stopping_.exchange(true)) {
+            return;
+        }
+        // Shutting a socket down wakes the threads blocked on it.
+        ::shutdown(listenFd_, SHUT_RDWR);
+        acceptor_.join();
+        ::close(listenFd_);
+        if (!unixPath_.empty()) {
+            ::unlink(unixPath_.c_str());
+        }
+        {
+            std::unique_lock<std::mutex> lock(connectionMutex_);
+            for (auto &weak : connections_) {
+                if (auto connection = weak.lock()) {
+                    ::shutdown(connection->fd_, SHUT_RDWR);
+                }
+            }
+            threadDone_.wait(lock, [this] { return readerCnt_ == 0; });
+        }
+        requests_.close();
+        dispatcher_.join();
+        // With every request answered, the writers finish once their sends fail on the shut down sockets.
+        std::unique_lock<std::mutex> lock(connectionMutex_);
+        threadDone_.wait(lock, [this] { return writerCnt_ == 0; });
+    }
+
+    uint64_t SolveServer::answered() const {
+        return answered_.load(std::memory_order_relaxed);
+    }
+
+    void SolveServer::acceptLoop() {
+        while (!stopping_) {
+            int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+            // Answers are small and should leave at once.
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            timeval timeout{};
+            timeout.tv_sec = static_cast<time_t>(options_.sendTimeout_);
+            timeout.tv_usec = static_cast<suseconds_t>((options_.sendTimeout_ - timeout.tv_sec) * 1e6);
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            auto connection = std::make_shared<Connection>(fd);
+            std::lock_guard<std::mutex> lock(connectionMutex_);
+            if (stopping_) {
+                return;
+            }
+            std::erase_if(connections_, [](const auto &weak) { return weak.expired(); });
+            connections_.push_back(connection);
+            spawnCounted(readerCnt_, [this, connection] { readLoop(connection); });
+            spawnCounted(writerCnt_, [this, connection] { writeLoop(connection); });
+        }
+    }
+
+    template<typename Body>
+    void SolveServer::spawnCounted(unsigned &cnt, Body body) {
+        cnt += 1;
+        std::thread([this, &cnt, body] {
+            body();
+            std::lock_guard<std::mutex> lock(connectionMutex_);
+            if (--cnt == 0) {
+                threadDone_.notify_all();
+            }
+        }).detach();
+    }
+
+    void SolveServer::drop(Connection &connection) {
+        connection.dropped_ = true;
+        connection.outbox_.clear();
+        ::shutdown(connection.fd_, SHUT_RDWR);
+        connection.changed_.notify_all();
+    }
+
+    void SolveServer::readLoop(std::shared_ptr<Connection> connection) {
+        readRequests(connection);
+        std::lock_guard<std::mutex> lock(connection->mutex_);
+        connection->reading_ = false;
+        connection->changed_.notify_all();
+    }
+
+    void SolveServer::readRequests(const std::shared_ptr<Connection> &connection) {
+        std::string buffer;
+        char chunk[4096];
+        while (true) {
+            ssize_t n = ::recv(connection->fd_, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            size_t begin = 0, end;
+            while ((end = buffer.find('\n', begin)) != std::string::npos) {
+                Request request{connection, buffer.substr(begin, end - begin), std::chrono::steady_clock::now(), {}};
+                if (!request.line_.empty() && request.line_.back() == '\r') {
+                    request.line_.pop_back();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(connection->mutex_);
+                    connection->pending_ += 1;
+                }
+                if (!requests_.push(std::move(request))) {
+                    std::lock_guard<std::mutex> lock(connection->mutex_);
+                    connection->pending_ -= 1;
+                    return;
+                }
+                begin = end + 1;
+            }
+            buffer.erase(0, begin);
+            if (buffer.size() > options_.maxLineLength_) {
+                return;
+            }
+        }
+    }
+
+    void SolveServer::dispatchLoop() {
+        std::vector<Request> batch;
+        // Answers of the batch and their number, gathered per connection to post each at once.
+        struct Reply {
+            Connection *connection_;
+            std::string text_;
+            size_t cnt_;
+        };
+        std::vector<Reply> replies;
+        while (true) {
+            batch.clear();
+            if (requests_.popMany(batch, options_.maxBatch_) == 0) {
+                return;
+            }
+            auto batchBegin = std::chrono::steady_clock::now();
+            pool_.parallelFor(batch.size(), 1, [&](uint64_t begin, uint64_t end) {
+                for (uint64_t i = begin; i < end; ++i) {
+                    answer(batch[i], batchBegin, batch.size());
+                }
+            });
+            replies.clear();
+            for (auto &request : batch) {
+                auto it = std::find_if(replies.begin(), replies.end(), [&](const Reply &reply) {
+                    return reply.connection_ == request.connection_.get();
+                });
+                if (it == replies.end()) {
+                    it = replies.insert(replies.end(), Reply{request.connection_.get(), std::string(), 0});
+                }
+                it->text_ += request.answer_;
+                it->cnt_ += 1;
+            }
+            for (auto &reply : replies) {
+                post(*reply.connection_, reply.text_, reply.cnt_);
+            }
+            answered_.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+    }
+
+    void SolveServer::post(Connection &connection, const std::string &text, size_t answered) {
+        std::lock_guard<std::mutex> lock(connection.mutex_);
+        connection.pending_ -= answered;
+        if (!connection.dropped_) {
+            if (connection.outbox_.size() + text.size() > options_.maxPendingBytes_) {
+                drop(connection);
+            } else {
+                connection.outbox_ += text;
+            }
+        }
+        connection.changed_.notify_all();
+    }
+
+    void SolveServer::writeLoop(std::shared_ptr<Connection> connection) {
+        std::string sending;
+        std::unique_lock<std::mutex> lock(connection->mutex_);
+        while (true) {
+            connection->changed_.wait(lock, [&] {
+                return connection->dropped_ || !connection->outbox_.empty() ||
+                       (!connection->reading_ && connection->pending_ == 0);
+            });
+            if (connection->dropped_ || connection->outbox_.empty()) {
+                return;
+            }
+            sending.clear();
+            sending.swap(connection->outbox_);
+            lock.unlock();
+            // Blocks for at most sendTimeout_ per call, by SO_SNDTIMEO.
+            bool sent = sendAll(connection->fd_, sending);
+            lock.lock();
+            if (!sent) {
+                drop(*connection);
+                return;
+            }
+        }
+    }
+
+    void SolveServer::answer(Request &request, std::chrono::steady_clock::time_point batchBegin,
+                             size_t batchSize) const {
+        if (request.line_.empty()) {
+            request.answer_ = "\n";
+            return;
+        }
+        CubeStatus cube;
+        try {
+            cube = StreamSolver::parseCube(request.line_);
+        } catch (const std::invalid_argument &e) {
+            request.answer_.append("error: ").append(e.what()).push_back('\n');
+            return;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        TwoPhaseSolver::SolveResult result;
+        bool cached = cache_ != nullptr && cache_->lookup(cube, result.solution_) &&
+                      static_cast<int>(result.solution_.size()) <= options_.maxLength_;
+        if (!cached) {
+            result = solver_.solveWithStats(cube, options_.maxLength_);
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (result.solution_.empty() && cube != MoveFactory::Id_) {
+            request.answer_.append("error: no solution within ").append(std::to_string(options_.maxLength_))
+                    .append(" moves\n");
+            return;
+        }
+        if (cache_ != nullptr && !cached) {
+            cache_->insert(cube, result.solution_.data(), static_cast<int>(result.solution_.size()));
+        }
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        char stats[160];
+        std::snprintf(stats, sizeof(stats), "\tlength=%zu nodes=%llu wait_us=%lld solve_us=%lld batch=%zu cached=%d\n",
+                      result.solution_.size(),
+                      static_cast<unsigned long long>(result.stats_.phaseOne_.totalNodes() +
+                                                      result.stats_.phaseTwo_.totalNodes()),
+                      static_cast<long long>(duration_cast<microseconds>(batchBegin - request.received_).count()),
+                      static_cast<long long>(duration_cast<microseconds>(end - begin).count()), batchSize,
+                      cached ? 1 : 0);
+        request.answer_ = Notation::toString(result.solution_);
+        request.answer_ += stats;
+    }
+
+    bool SolveServer::sendAll(int fd, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+#endif //CUBE_SOLVER_SOLVE_SERVER_H
@@ -0,0 +1,297 @@
+#ifndef CUBE_SOLVER_STREAM_SOLVER_H
+#define CUBE_SOLVER_STREAM_SOLVER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <chrono>
+#include <semaphore>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cube_def.h"
+#include "facelet.h"
+#include "notation.h"
+#include "thread_pool.h"
+#include "two_phase_solver.h"
+#include "solution_cache.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    // Lines of a file mapped into memory, or of a stream read through a buffer.
+    class LineReader {
+    public:
+        explicit LineReader(const std::string &path);
+
+        explicit LineReader(std::istream &in);
+
+        LineReader(const LineReader &) = delete;
+
+        void operator=(const LineReader &) = delete;
+
+        ~LineReader();
+
+        // Next line without its line break, valid until the next call. Returns false at the end.
+        bool next(std::string_view &line);
+
+    protected:
+        std::istream *in_ = nullptr;
+        std::string buffer_;
+
+        void *map_ = nullptr;
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+        size_t pos_ = 0;
+    };
+
+    /*
+     * Solves a stream of scrambles, one per line, and writes one solution per line in input order.
+     *
+     * A line of exactly 54 face letters is a facelet string, see Facelets, any other line a scramble in
+     * Notation, whose solution is written in the same notation. Lines which fail to parse or solve give a
+     * line starting with "error: ", and empty lines give empty lines.
+     *
+     * A reader thread cuts the input into batches of lines, the threads of the pool solve them, and a
+     * writer thread puts them back in order. At most a fixed number of batches is between reader and
+     * writer at any time, so memory use does not grow with the input.
+     * */
+    class StreamSolver {
+    public:
+        struct Options {
+            int maxLength_ = 30;
+            size_t batchSize_ = 64;
+            // Batches in flight per solving thread.
+            size_t batchesPerThread_ = 4;
+            // Solutions remembered by a SolutionCache, none if 0.
+            size_t cacheCapacity_ = 0;
+        };
+
+        struct Summary {
+            uint64_t lines_ = 0;
+            uint64_t errors_ = 0;
+            double seconds_ = 0;
+        };
+
+        StreamSolver(const TwoPhaseSolver &solver, ThreadPool &pool, Options options);
+
+        StreamSolver(const TwoPhaseSolver &solver, ThreadPool &pool);
+
+        Summary run(LineReader &in, std::ostream &out);
+
+        // Cube given by a facelet string or a scramble, see above. Throws std::invalid_argument otherwise.
+        static CubeStatus parseCube(std::string_view line);
+
+        // Append the output line for one input line, without the line break, and return whether it is a
+        // solution.
+        bool solveLine(std::string_view line, TwoPhaseSolver::SearchContext &context, std::string &out) const;
+
+    protected:
+        struct Batch {
+            uint64_t seq_ = 0;
+            // Input lines back to back, ending at lineEnd_, and later the output with its line breaks.
+            std::string text_;
+            std::vector<uint32_t> lineEnd_;
+            uint64_t errors_ = 0;
+        };
+
+        const TwoPhaseSolver &solver_;
+        ThreadPool &pool_;
+        Options options_;
+        std::unique_ptr<SolutionCache> cache_;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    LineReader::LineReader(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string(__func__) + ": cannot open " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error(std::string(__func__) + ": cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            map_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map_ == MAP_FAILED) {
+                map_ = nullptr;
+                ::close(fd);
+                throw std::runtime_error(std::string(__func__) + ": cannot map " + path);
+            }
+            // Pages are read once, front to back.
+            ::madvise(map_, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(map_);
+        }
+        ::close(fd);
+    }
+
+    LineReader::LineReader(std::istream &in) : in_(&in) {}
+
+    LineReader::~LineReader() {
+        if (map_ != nullptr) {
+            ::munmap(map_, size_);
+        }
+    }
+
+    bool LineReader::next(std::string_view &line) {
+        if (in_ != nullptr) {
+            if (!std::getline(*in_, buffer_)) {
+                return false;
+            }
+            line = buffer_;
+        } else {
+            if (pos_ >= size_) {
+                return false;
+            }
+            auto end = static_cast<const char *>(std::memchr(data_ + pos_, '\n', size_ - pos_));
+            size_t len = end == nullptr ? size_ - pos_ : static_cast<size_t>(end - (data_ + pos_));
+            line = std::string_view(data_ + pos_, len);
+            pos_ += len + 1;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return true;
+    }
+
+    StreamSolver::StreamSolver(const TwoPhaseSolver &solver, ThreadPool &pool, Options options)
+            : solver_(solver), pool_(pool), options_(options) {
+        if (options_.cacheCapacity_ != 0) {
+            cache_ = std::make_unique<SolutionCache>(options_.cacheCapacity_);
+        }
+    }
+
+    StreamSolver::StreamSolver(const TwoPhaseSolver &solver, ThreadPool &pool)
+            : StreamSolver(solver, pool, Options()) {}
+
+    CubeStatus StreamSolver::parseCube(std::string_view line) {
+        if (line.size() == Facelets::FaceletCnt && line.find_first_not_of("URFDLB") == std::string_view::npos) {
+            return Facelets::parse(line);
+        }
+        thread_local std::vector<MoveName> moves;
+        moves.clear();
+        Notation::parseMoves(line, moves);
+        CubeStatus cube = MoveFactory::Id_;
+        for (auto m : moves) {
+            cube = MoveFactory::getMoveByName(m) * cube;
+        }
+        return cube;
+    }
+
+    bool StreamSolver::solveLine(std::string_view line, TwoPhaseSolver::SearchContext &context,
+                                 std::string &out) const {
+        if (line.empty()) {
+            return true;
+        }
+        CubeStatus cube;
+        try {
+            cube = parseCube(line);
+        } catch (const std::invalid_argument &e) {
+            out.append("error: ").append(e.what());
+            return false;
+        }
+        thread_local std::vector<MoveName> cached;
+        if (cache_ != nullptr && cache_->lookup(cube, cached) &&
+            static_cast<int>(cached.size()) <= options_.maxLength_) {
+            Notation::appendMoves(cached.data(), static_cast<int>(cached.size()), out);
+            return true;
+        }
+        if (!solver_.solve(cube, context, options_.maxLength_)) {
+            out.append("error: no solution within ").append(std::to_string(options_.maxLength_)).append(" moves");
+            return false;
+        }
+        if (cache_ != nullptr) {
+            cache_->insert(cube, context.solution_, context.length_);
+        }
+        Notation::appendMoves(context.solution_, context.length_, out);
+        return true;
+    }
+
+    StreamSolver::Summary StreamSolver::run(LineReader &in, std::ostream &out) {
+        auto begin = std::chrono::steady_clock::now();
+        unsigned threadCnt = pool_.size() + 1;
+        size_t inFlight = options_.batchesPerThread_ * threadCnt;
+        BoundedQueue<Batch> todo(inFlight), done(inFlight);
+        // Batches read but not yet written, which bounds the reordering buffer of the writer.
+        std::counting_semaphore<> slots(static_cast<std::ptrdiff_t>(inFlight));
+        Summary summary;
+
+        std::thread reader([&] {
+            std::string_view line;
+            bool more = true;
+            for (uint64_t seq = 0; more; ++seq) {
+                Batch batch;
+                batch.seq_ = seq;
+                while (batch.lineEnd_.size() < options_.batchSize_ && (more = in.next(line))) {
+                    batch.text_.append(line);
+                    batch.lineEnd_.push_back(static_cast<uint32_t>(batch.text_.size()));
+                }
+                if (batch.lineEnd_.empty()) {
+                    break;
+                }
+                summary.lines_ += batch.lineEnd_.size();
+                slots.acquire();
+                todo.push(std::move(batch));
+            }
+            todo.close();
+        });
+
+        std::thread writer([&] {
+            std::map<uint64_t, Batch> pending;
+            uint64_t nextSeq = 0;
+            Batch batch;
+            while (done.pop(batch)) {
+                pending.emplace(batch.seq_, std::move(batch));
+                for (auto it = pending.begin(); it != pending.end() && it->first == nextSeq;
+                     it = pending.erase(it), ++nextSeq) {
+                    out.write(it->second.text_.data(), static_cast<std::streamsize>(it->second.text_.size()));
+                    summary.errors_ += it->second.errors_;
+                    slots.release();
+                }
+            }
+            out.flush();
+        });
+
+        pool_.parallelFor(threadCnt, 1, [&](uint64_t, uint64_t) {
+            TwoPhaseSolver::SearchContext context;
+            std::string text;
+            Batch batch;
+            while (todo.pop(batch)) {
+                text.clear();
+                uint32_t lineBegin = 0;
+                for (auto lineEnd : batch.lineEnd_) {
+                    auto line = std::string_view(batch.text_).substr(lineBegin, lineEnd - lineBegin);
+                    batch.errors_ += !solveLine(line, context, text);
+                    text.push_back('\n');
+                    lineBegin = lineEnd;
+                }
+                batch.text_.swap(text);
+                done.push(std::move(batch));
+            }
+        });
+        done.close();
+        reader.join();
+        writer.join();
+        summary.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        return summary;
+    }
+}
+
+#endif //CUBE_SOLVER_STREAM_SOLVER_H
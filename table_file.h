@@ -0,0 +1,288 @@
+#ifndef CUBE_SOLVER_TABLE_FILE_H
+#define CUBE_SOLVER_TABLE_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "numa.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    /*
+     * Memory holding a set of tables, either anonymous memory filled by the caller or a table file
+     * mapped read-only, so that processes loading the same file share one copy in the page cache.
+     *
+     * The tables are laid out back to back as sections, each starting at a multiple of SectionAlign.
+     * A table file is a header page followed by these sections. The header records the format version,
+     * the size of each section and a checksum of the payload. A file only maps if the version and sizes
+     * match. Checking the checksum reads the whole file, so it is left to verify, keeping mapping cheap.
+     *
+     * The searches look up the tables at random, so the storage asks for huge pages, which cut the TLB
+     * misses of the lookups. Anonymous memory is aligned for transparent huge pages. For mapped files they
+     * depend on the file system and kernel, and plain pages are used where they are unavailable.
+     * */
+    class TableStorage {
+    public:
+        // Raised whenever the sections of a table file or their encoding change.
+        static constexpr uint32_t Version = 2;
+        static constexpr uint64_t SectionAlign = 64;
+        static constexpr uint64_t HeaderSize = 4096;
+        static constexpr uint32_t MaxSectionCnt = 64;
+        static constexpr uint64_t HugePageSize = 2 << 20;
+
+        TableStorage() = default;
+
+        TableStorage(const TableStorage &) = delete;
+
+        void operator=(const TableStorage &) = delete;
+
+        TableStorage(TableStorage &&other) noexcept;
+
+        TableStorage &operator=(TableStorage &&other) noexcept;
+
+        ~TableStorage();
+
+        // Zero filled, writable storage for sections of the given byte sizes.
+        static TableStorage allocate(const std::vector<uint64_t> &sectionSize);
+
+        // Map a table file, returning empty storage if it is missing or does not match sectionSize. Only the
+        // header is read, see verify.
+        static TableStorage map(const std::string &path, const std::vector<uint64_t> &sectionSize);
+
+        // Whether the payload of a mapped file matches the checksum of its header. Reads every page.
+        bool verify() const;
+
+        // Private, writable copy placed on a NUMA node, or spread over all nodes for NumaTopology::AllNodes.
+        TableStorage copy(int node) const;
+
+        // Write the storage to path. The file is written aside and renamed, so readers never see it half
+        // written.
+        bool save(const std::string &path) const;
+
+        bool empty() const;
+
+        bool mapped() const;
+
+        uint8_t *section(uint32_t i) const;
+
+        static uint64_t checksum(const uint8_t *data, uint64_t size);
+
+    protected:
+        struct Header {
+            char magic_[8];
+            uint32_t version_;
+            uint32_t sectionCnt_;
+            uint64_t payloadSize_;
+            uint64_t checksum_;
+            uint64_t sectionSize_[MaxSectionCnt];
+        };
+        static_assert(sizeof(Header) <= HeaderSize, "table file header must fit in its page");
+
+        static constexpr char Magic[8] = "CUBETBL";
+
+        // Whole mapping, the header page included for files.
+        uint8_t *base_ = nullptr;
+        uint64_t length_ = 0;
+        uint8_t *payload_ = nullptr;
+        bool mapped_ = false;
+        std::vector<uint64_t> sectionSize_;
+        std::vector<uint64_t> sectionOffset_;
+
+        static uint64_t layout(const std::vector<uint64_t> &sectionSize, std::vector<uint64_t> &sectionOffset);
+
+        static void adviseHugePages(void *p, uint64_t length);
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    TableStorage::TableStorage(TableStorage &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    TableStorage &TableStorage::operator=(TableStorage &&other) noexcept {
+        if (this != &other) {
+            if (base_ != nullptr) {
+                munmap(base_, length_);
+            }
+            base_ = other.base_;
+            length_ = other.length_;
+            payload_ = other.payload_;
+            mapped_ = other.mapped_;
+            sectionSize_ = std::move(other.sectionSize_);
+            sectionOffset_ = std::move(other.sectionOffset_);
+            other.base_ = nullptr;
+            other.length_ = 0;
+            other.payload_ = nullptr;
+        }
+        return *this;
+    }
+
+    TableStorage::~TableStorage() {
+        if (base_ != nullptr) {
+            munmap(base_, length_);
+        }
+    }
+
+    uint64_t TableStorage::layout(const std::vector<uint64_t> &sectionSize, std::vector<uint64_t> &sectionOffset) {
+        uint64_t size = 0;
+        sectionOffset.clear();
+        for (auto s : sectionSize) {
+            sectionOffset.push_back(size);
+            size += (s + SectionAlign - 1) / SectionAlign * SectionAlign;
+        }
+        return size;
+    }
+
+    TableStorage TableStorage::allocate(const std::vector<uint64_t> &sectionSize) {
+        TableStorage res;
+        res.sectionSize_ = sectionSize;
+        res.length_ = layout(sectionSize, res.sectionOffset_);
+        // Huge pages only back aligned ranges, so an aligned range is cut out of a larger mapping.
+        auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        uint64_t length = (res.length_ + pageSize - 1) / pageSize * pageSize;
+        void *p = mmap(nullptr, length + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(std::string(__func__) + ": cannot allocate table memory");
+        }
+        auto begin = reinterpret_cast<uintptr_t>(p);
+        uintptr_t aligned = (begin + HugePageSize - 1) / HugePageSize * HugePageSize;
+        if (aligned != begin) {
+            munmap(p, aligned - begin);
+        }
+        munmap(reinterpret_cast<void *>(aligned + length), begin + HugePageSize - aligned);
+        adviseHugePages(reinterpret_cast<void *>(aligned), length);
+        res.base_ = reinterpret_cast<uint8_t *>(aligned);
+        res.payload_ = res.base_;
+        return res;
+    }
+
+    TableStorage TableStorage::map(const std::string &path, const std::vector<uint64_t> &sectionSize) {
+        TableStorage res;
+        if (sectionSize.size() > MaxSectionCnt) {
+            return res;
+        }
+        uint64_t payloadSize = layout(sectionSize, res.sectionOffset_);
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return res;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != HeaderSize + payloadSize) {
+            close(fd);
+            return res;
+        }
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            return res;
+        }
+        adviseHugePages(p, st.st_size);
+        res.base_ = static_cast<uint8_t *>(p);
+        res.length_ = st.st_size;
+        res.payload_ = res.base_ + HeaderSize;
+        res.mapped_ = true;
+        res.sectionSize_ = sectionSize;
+
+        Header header{};
+        std::memcpy(&header, res.base_, sizeof(Header));
+        bool valid = std::memcmp(header.magic_, Magic, sizeof(Magic)) == 0 && header.version_ == Version &&
+                     header.sectionCnt_ == sectionSize.size() && header.payloadSize_ == payloadSize &&
+                     std::equal(sectionSize.begin(), sectionSize.end(), header.sectionSize_);
+        if (!valid) {
+            return TableStorage();
+        }
+        return res;
+    }
+
+    TableStorage TableStorage::copy(int node) const {
+        auto res = allocate(sectionSize_);
+        // Placed before the pages are touched, as placement only applies to pages faulted in later.
+        NumaTopology::get().placeMemory(res.base_, res.length_, node);
+        std::memcpy(res.payload_, payload_, res.length_);
+        return res;
+    }
+
+    bool TableStorage::verify() const {
+        if (!mapped_) {
+            return false;
+        }
+        Header header{};
+        std::memcpy(&header, base_, sizeof(Header));
+        return header.checksum_ == checksum(payload_, length_ - HeaderSize);
+    }
+
+    bool TableStorage::save(const std::string &path) const {
+        if (empty() || sectionSize_.size() > MaxSectionCnt) {
+            return false;
+        }
+        uint64_t payloadSize = mapped_ ? length_ - HeaderSize : length_;
+        Header header{};
+        std::memcpy(header.magic_, Magic, sizeof(Magic));
+        header.version_ = Version;
+        header.sectionCnt_ = static_cast<uint32_t>(sectionSize_.size());
+        header.payloadSize_ = payloadSize;
+        header.checksum_ = checksum(payload_, payloadSize);
+        std::copy(sectionSize_.begin(), sectionSize_.end(), header.sectionSize_);
+        std::vector<char> headerPage(HeaderSize, 0);
+        std::memcpy(headerPage.data(), &header, sizeof(Header));
+
+        std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            out.write(headerPage.data(), static_cast<std::streamsize>(HeaderSize));
+            out.write(reinterpret_cast<const char *>(payload_), static_cast<std::streamsize>(payloadSize));
+            if (!out) {
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    bool TableStorage::empty() const {
+        return base_ == nullptr;
+    }
+
+    bool TableStorage::mapped() const {
+        return mapped_;
+    }
+
+    uint8_t *TableStorage::section(uint32_t i) const {
+        return payload_ + sectionOffset_[i];
+    }
+
+    void TableStorage::adviseHugePages(void *p, uint64_t length) {
+#ifdef MADV_HUGEPAGE
+        // Only a hint, which fails where huge pages are unsupported.
+        madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    uint64_t TableStorage::checksum(const uint8_t *data, uint64_t size) {
+        // FNV-1a over 64-bit words, the payload size is always a multiple of SectionAlign.
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (uint64_t i = 0; i + 8 <= size; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            h = (h ^ w) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+}
+
+#endif //CUBE_SOLVER_TABLE_FILE_H
@@ -1,10 +1,134 @@
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <new>
 #include <gtest/gtest.h>
 
 #include "utility.h"
 #include "cube_def.h"
+#include "facelet.h"
+#include "notation.h"
+#include "coord_batch.h"
 #include "two_phase_solver.h"
+#include "stream_solver.h"
+#include "solve_server.h"
+#include "solution_cache.h"
+#include "optimal_solver.h"
+
+// Heap allocations made by the current thread while countAllocations is set.
+static thread_local bool countAllocations = false;
+static thread_local uint64_t allocationCnt = 0;
+
+// Every replaceable form of new counts, so that no allocation path escapes the count.
+static void *countedAlloc(std::size_t size, std::size_t align) noexcept {
+    if (countAllocations) {
+        allocationCnt += 1;
+    }
+    size = size == 0 ? 1 : size;
+    if (align <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+static void *countedAllocOrThrow(std::size_t size, std::size_t align) {
+    void *p = countedAlloc(size, align);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(std::size_t size) {
+    return countedAllocOrThrow(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return countedAllocOrThrow(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return countedAllocOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align) {
+    return countedAllocOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, 0);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+static const std::string TablePath = "cube_solver_tables.bin";
+
+// Building the tables takes a while, so all tests share one solver and later runs map them from disk.
+static Cube::TwoPhaseSolver &sharedSolver() {
+    static Cube::TwoPhaseSolver solver(TablePath);
+    return solver;
+}
 
 TEST(CubeTest, UDSLiceIndex) {
     using namespace Cube;
@@ -36,7 +160,7 @@ TEST(CubeTest, MoveOrd) {
 namespace Cube {
     TEST(CubeTest, UDSliceMoveTable) {
         using namespace Cube;
-        auto solver = TwoPhaseSolver();
+        auto &solver = sharedSolver();
         for (int i = 0; i < TwoPhaseSolver::UDSliceCnt; ++i) {
             auto status = solver.moveFactory.getByUDSliceCoord(i);
             for (int face = 0; face <= BasicMoveName::R; ++face) {
@@ -48,3 +172,1043 @@ namespace Cube {
         }
     }
 }
+
+namespace Cube {
+    TEST(CubeTest, CompileTimeTables) {
+        using namespace Cube;
+        static_assert(ConstantFactory::getBiCoef(12, 4) == TwoPhaseSolver::UDSliceCnt);
+        static_assert(ConstantFactory::getFactorial(8) == TwoPhaseSolver::ConorPermCnt);
+        static_assert(MoveFactory::Moves_[U1] * MoveFactory::Moves_[U3] == MoveFactory::Id_);
+        static_assert(MoveFactory::Sym_[16] * MoveFactory::Sym_[MoveFactory::SymInv_[16]] == MoveFactory::Id_);
+        // The solved slice stays solved under U and D, but not under R.
+        static_assert(TwoPhaseSolver::UDSliceMoveTable_[0][U1] == 0);
+        static_assert(TwoPhaseSolver::UDSliceMoveTable_[0][R1] != 0);
+        static_assert(TwoPhaseSolver::SlicePermMoveTable_[0][0] == 0);
+        // The tables computed by the compiler agree with the runtime composition.
+        for (int i = 0; i < 20; ++i) {
+            auto cube = MoveFactory::getInstance().genRandomCube();
+            for (int m = 0; m < TwoPhaseSolver::MoveCnt; ++m) {
+                auto c = MoveFactory::getMoveByName(static_cast<MoveName>(m)) * cube;
+                EXPECT_EQ(c.getUDSliceCoord(), TwoPhaseSolver::UDSliceMoveTable_[cube.getUDSliceCoord()][m]);
+            }
+        }
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, PhaseOneMoveTable) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        for (int i = 0; i < TwoPhaseSolver::TwistCnt; ++i) {
+            auto status = solver.moveFactory.getByConorOriCoord(i);
+            EXPECT_EQ(status.getConorOriCoord(), i);
+            for (int m = 0; m < TwoPhaseSolver::MoveCnt; ++m) {
+                auto co = (solver.moveFactory.getMoveByName(static_cast<MoveName>(m)) * status).getConorOriCoord();
+                EXPECT_EQ(co, solver.TwistMoveTable_[i][m]);
+            }
+        }
+        for (int i = 0; i < TwoPhaseSolver::FlipCnt; ++i) {
+            auto status = solver.moveFactory.getByEdgeOriCoord(i);
+            EXPECT_EQ(status.getEdgeOriCoord(), i);
+            for (int m = 0; m < TwoPhaseSolver::MoveCnt; ++m) {
+                auto co = (solver.moveFactory.getMoveByName(static_cast<MoveName>(m)) * status).getEdgeOriCoord();
+                EXPECT_EQ(co, solver.FlipMoveTable_[i][m]);
+            }
+        }
+    }
+}
+
+TEST(CubeTest, PhaseOneSearch) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int i = 0; i < 20; ++i) {
+        auto status = moveFactory.genRandomCube();
+        auto path = solver.phaseOneSearch(status);
+        EXPECT_LE(path.size(), 12);
+        for (auto m : path) {
+            status = moveFactory.getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status.getConorOriCoord(), 0);
+        EXPECT_EQ(status.getEdgeOriCoord(), 0);
+        EXPECT_EQ(status.getUDSliceCoord(), 0);
+    }
+}
+
+TEST(CubeTest, PermCoordIndex) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    for (int i = 0; i < 40320; ++i) {
+        EXPECT_EQ(moveFactory.getByConorPermCoord(i).getConorPermCoord(), i);
+        EXPECT_EQ(moveFactory.getByPhase2EdgePermCoord(i).getPhase2EdgePermCoord(), i);
+    }
+    for (int i = 0; i < 495 * 24; ++i) {
+        EXPECT_EQ(moveFactory.getByUDSliceSortedCoord(i).getUDSliceSortedCoord(), i);
+        EXPECT_EQ(moveFactory.getByUEdgesCoord(i).getUEdgesCoord(), i);
+        EXPECT_EQ(moveFactory.getByDEdgesCoord(i).getDEdgesCoord(), i);
+    }
+    // Exactly the coordinates below 1680 keep the U edges in the U and D layers.
+    for (int i = 0; i < 495 * 24; ++i) {
+        auto cube = moveFactory.getByUEdgesCoord(i);
+        bool inLayers = true;
+        for (int e = BlockPos::FR; e <= BlockPos::BR; ++e) {
+            inLayers &= cube.move_[e].pos() >= BlockPos::DR;
+        }
+        EXPECT_EQ(inLayers, i < 1680) << i;
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, PhaseTwoMoveTable) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        for (int i = 0; i < TwoPhaseSolver::ConorPermCnt; i += 7) {
+            auto conor = solver.moveFactory.getByConorPermCoord(i);
+            auto edge = solver.moveFactory.getByPhase2EdgePermCoord(i);
+            for (int k = 0; k < TwoPhaseSolver::Phase2MoveCnt; ++k) {
+                auto &m = solver.moveFactory.getMoveByName(TwoPhaseSolver::Phase2Moves[k]);
+                EXPECT_EQ((m * conor).getConorPermCoord(), solver.ConorPermMoveTable_[i][k]);
+                EXPECT_EQ((m * edge).getPhase2EdgePermCoord(), solver.Phase2EdgePermMoveTable_[i][k]);
+            }
+        }
+    }
+
+    TEST(CubeTest, PhaseTwoEntry) {
+        auto &solver = sharedSolver();
+        auto &moveFactory = MoveFactory::getInstance();
+        RandomFactory::Engine engine(23);
+        std::uniform_int_distribution<int> anyMove(0, TwoPhaseSolver::MoveCnt - 1);
+        std::uniform_int_distribution<int> anyPhase2Move(0, TwoPhaseSolver::Phase2MoveCnt - 1);
+        for (int i = 0; i < 100; ++i) {
+            // The tables follow a cube along a path of any moves.
+            auto cube = MoveFactory::genUniformCube(engine);
+            TwoPhaseSolver::PhaseTwoEntry entry;
+            entry.reset(cube);
+            uint16_t conorPerm = entry.conorPerm_[0], sliceSorted = entry.sliceSorted_[0];
+            uint16_t uEdges = entry.uEdges_[0], dEdges = entry.dEdges_[0];
+            for (int n = 0; n < 20; ++n) {
+                int m = anyMove(engine);
+                cube = MoveFactory::Moves_[m] * cube;
+                conorPerm = solver.ConorPermFullMoveTable_[conorPerm][m];
+                sliceSorted = solver.UDSliceSortedMoveTable_[sliceSorted][m];
+                uEdges = solver.UEdgesMoveTable_[uEdges][m];
+                dEdges = solver.DEdgesMoveTable_[dEdges][m];
+                ASSERT_EQ(conorPerm, cube.getConorPermCoord());
+                ASSERT_EQ(sliceSorted, cube.getUDSliceSortedCoord());
+                ASSERT_EQ(uEdges, cube.getUEdgesCoord());
+                ASSERT_EQ(dEdges, cube.getDEdgesCoord());
+            }
+
+            // In G1 the U and D edges merge into the phase 2 edge permutation.
+            auto g1 = moveFactory.Id_;
+            for (int n = 0; n < 30; ++n) {
+                g1 = moveFactory.getMoveByName(TwoPhaseSolver::Phase2Moves[anyPhase2Move(engine)]) * g1;
+            }
+            ASSERT_LT(g1.getUEdgesCoord(), TwoPhaseSolver::Phase2UDEdgesCnt);
+            ASSERT_LT(g1.getUDSliceSortedCoord(), TwoPhaseSolver::SlicePermCnt);
+            EXPECT_EQ(solver.Phase2EdgeMerge_[g1.getUEdgesCoord()][g1.getDEdgesCoord() % TwoPhaseSolver::SlicePermCnt],
+                      g1.getPhase2EdgePermCoord());
+        }
+    }
+}
+
+TEST(CubeTest, Solve) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int i = 0; i < 10; ++i) {
+        auto status = moveFactory.genRandomCube();
+        auto solution = solver.solve(status);
+        EXPECT_FALSE(solution.empty());
+        EXPECT_LE(solution.size(), 30);
+        for (auto m : solution) {
+            status = moveFactory.getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status, moveFactory.Id_);
+    }
+}
+
+TEST(CubeTest, SolveWithStats) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int i = 0; i < 10; ++i) {
+        auto status = moveFactory.genRandomCube();
+        auto res = solver.solveWithStats(status);
+        EXPECT_EQ(res.solution_, solver.solve(status));
+        const auto &stats = res.stats_;
+        // The root is expanded once per IDA* iteration, and every phase one solution searched comes first.
+        EXPECT_GE(stats.phaseOne_.nodes_[0], 1);
+        EXPECT_GE(stats.phaseOneSolutions_, 1);
+        EXPECT_GE(stats.phaseTwoSearches_, 1);
+        EXPECT_LE(stats.phaseTwoSearches_, stats.phaseOneSolutions_);
+        EXPECT_GE(stats.phaseTwo_.nodes_[0], stats.phaseTwoSearches_);
+        EXPECT_LE(stats.phaseOne_.cutoffs_, stats.phaseOne_.children_);
+        EXPECT_LE(stats.phaseTwo_.cutoffs_, stats.phaseTwo_.children_);
+        EXPECT_GE(stats.phaseOne_.seconds_, 0);
+        EXPECT_GT(stats.phaseTwo_.seconds_, 0);
+    }
+}
+
+TEST(CubeTest, SolveAnytime) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int i = 0; i < 5; ++i) {
+        auto status = moveFactory.genRandomCube();
+        auto first = solver.solve(status);
+
+        // The first solution already meets a loose target.
+        TwoPhaseSolver::SolveBudget budget;
+        budget.targetLength_ = 30;
+        EXPECT_EQ(solver.solveAnytime(status, budget).solution_, first);
+
+        budget.targetLength_ = 20;
+        budget.seconds_ = 0.5;
+        auto res = solver.solveAnytime(status, budget);
+        EXPECT_FALSE(res.solution_.empty());
+        EXPECT_LE(res.solution_.size(), first.size());
+        auto cur = status;
+        for (auto m : res.solution_) {
+            cur = moveFactory.getMoveByName(m) * cur;
+        }
+        EXPECT_EQ(cur, moveFactory.Id_);
+
+        // The budget runs out at the first phase one solution, before any phase two search.
+        budget.nodes_ = 1;
+        res = solver.solveAnytime(status, budget);
+        EXPECT_TRUE(res.solution_.empty());
+        EXPECT_EQ(res.stats_.phaseTwoSearches_, 0);
+    }
+}
+
+TEST(CubeTest, AllocationFreeSolve) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    // Array, aligned and nothrow forms count like plain new.
+    struct alignas(64) Line {
+        char bytes_[64];
+    };
+    allocationCnt = 0;
+    countAllocations = true;
+    delete[] new int[4];
+    delete new Line;
+    delete new (std::nothrow) int;
+    countAllocations = false;
+    EXPECT_EQ(allocationCnt, 3);
+
+    TwoPhaseSolver::SearchContext context;
+    for (int i = 0; i < 10; ++i) {
+        auto status = moveFactory.genRandomCube();
+        allocationCnt = 0;
+        countAllocations = true;
+        bool found = solver.solve(status, context);
+        countAllocations = false;
+        EXPECT_EQ(allocationCnt, 0);
+        ASSERT_TRUE(found);
+        EXPECT_EQ(std::vector<MoveName>(context.solution_, context.solution_ + context.length_), solver.solve(status));
+    }
+}
+
+TEST(CubeTest, SolveBatch) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    std::vector<CubeStatus> cubes;
+    for (int i = 0; i < 24; ++i) {
+        cubes.push_back(moveFactory.genRandomCube());
+    }
+    ThreadPool pool(4);
+    auto solutions = solver.solveBatch(cubes, pool);
+    ASSERT_EQ(solutions.size(), cubes.size());
+    for (size_t i = 0; i < cubes.size(); ++i) {
+        EXPECT_FALSE(solutions[i].empty()) << i;
+        auto status = cubes[i];
+        for (auto m : solutions[i]) {
+            status = moveFactory.getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status, moveFactory.Id_) << i;
+    }
+}
+
+TEST(CubeTest, SolveParallel) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    ThreadPool pool(4);
+    for (int i = 0; i < 10; ++i) {
+        auto status = moveFactory.genRandomCube();
+        auto solution = solver.solveParallel(status, pool);
+        EXPECT_FALSE(solution.empty());
+        EXPECT_LE(solution.size(), 30);
+        for (auto m : solution) {
+            status = moveFactory.getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status, moveFactory.Id_);
+    }
+    // Phase one depths below the split depth are searched without the pool.
+    auto status = moveFactory.getMoveByName(F1) * moveFactory.getMoveByName(U2);
+    auto solution = solver.solveParallel(status, pool);
+    EXPECT_EQ(solution, solver.solve(status));
+    for (auto m : solution) {
+        status = moveFactory.getMoveByName(m) * status;
+    }
+    EXPECT_EQ(status, moveFactory.Id_);
+}
+
+TEST(CubeTest, SolveAnytimeDeadline) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    // The superflip, one of the hardest cubes, against a target no search reaches.
+    std::vector<MoveName> moves;
+    Notation::parseMoves("U R2 F B R B2 R U2 L B2 R U' D' R2 F R' L B2 U2 F2", moves);
+    auto status = moveFactory.Id_;
+    for (auto m : moves) {
+        status = moveFactory.getMoveByName(m) * status;
+    }
+    TwoPhaseSolver::SolveBudget budget;
+    budget.targetLength_ = 0;
+    budget.seconds_ = 0.02;
+    auto begin = std::chrono::steady_clock::now();
+    solver.solveAnytime(status, budget);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    EXPECT_LT(elapsed.count(), 10 * budget.seconds_);
+
+    // The searches poll the budget every 4096 nodes, and unwinding adds a few more.
+    budget.seconds_ = 0;
+    budget.nodes_ = 200000;
+    auto res = solver.solveAnytime(status, budget);
+    EXPECT_GE(res.stats_.phaseOne_.totalNodes() + res.stats_.phaseTwo_.totalNodes(), budget.nodes_);
+    EXPECT_LE(res.stats_.phaseOne_.totalNodes() + res.stats_.phaseTwo_.totalNodes(), budget.nodes_ + 2 * 4096);
+}
+
+TEST(CubeTest, SolveRacing) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int s = 0; s < 48; ++s) {
+        for (int m = 0; m < 18; ++m) {
+            auto conj = MoveFactory::conjugateMove(static_cast<MoveName>(m), s);
+            EXPECT_EQ(MoveFactory::conjugate(moveFactory.getMoveByName(conj), s), moveFactory.getMoveByName(static_cast<MoveName>(m)));
+        }
+    }
+    ThreadPool pool(4);
+    for (int i = 0; i < 5; ++i) {
+        auto status = moveFactory.genRandomCube();
+        TwoPhaseSolver::SolveBudget budget;
+        budget.targetLength_ = 20;
+        budget.seconds_ = 0.2;
+        auto res = solver.solveRacing(status, pool, budget);
+        EXPECT_FALSE(res.solution_.empty());
+        EXPECT_LE(res.solution_.size(), solver.solve(status).size());
+        EXPECT_GT(res.stats_.phaseTwoSearches_, 0);
+        for (auto m : res.solution_) {
+            status = moveFactory.getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status, moveFactory.Id_);
+    }
+    // The shared node budget runs out at the first phase one solution of every search.
+    TwoPhaseSolver::SolveBudget budget;
+    budget.nodes_ = 1;
+    auto res = solver.solveRacing(moveFactory.genRandomCube(), pool, budget);
+    EXPECT_TRUE(res.solution_.empty());
+    EXPECT_EQ(res.stats_.phaseTwoSearches_, 0);
+}
+
+namespace Cube {
+    TEST(CubeTest, PruningTable) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        // Plain breadth first search over conor permutation x slice permutation.
+        constexpr int cnt = TwoPhaseSolver::ConorPermCnt * TwoPhaseSolver::SlicePermCnt;
+        std::vector<uint8_t> dist(cnt, 0xff);
+        std::vector<int> frontier = {0};
+        dist[0] = 0;
+        while (!frontier.empty()) {
+            std::vector<int> next;
+            for (int idx : frontier) {
+                int cp = idx / TwoPhaseSolver::SlicePermCnt, sp = idx % TwoPhaseSolver::SlicePermCnt;
+                for (int k = 0; k < TwoPhaseSolver::Phase2MoveCnt; ++k) {
+                    int n = solver.ConorPermMoveTable_[cp][k] * TwoPhaseSolver::SlicePermCnt +
+                            solver.SlicePermMoveTable_[sp][k];
+                    if (dist[n] == 0xff) {
+                        dist[n] = dist[idx] + 1;
+                        next.push_back(n);
+                    }
+                }
+            }
+            frontier.swap(next);
+        }
+        for (int idx = 0; idx < cnt; ++idx) {
+            EXPECT_EQ(solver.ConorPermSliceHeuristic_.get(idx), dist[idx] % 3);
+        }
+        for (int idx = 0; idx < cnt; idx += 997) {
+            auto d = solver.ConorPermSliceHeuristic_.distance(idx, [&solver](uint64_t i, auto &&visit) {
+                solver.conorPermSliceNeighbours(i, visit);
+            });
+            EXPECT_EQ(d, dist[idx]);
+        }
+    }
+}
+
+TEST(CubeTest, Symmetry) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    for (int s = 0; s < 48; ++s) {
+        EXPECT_EQ(moveFactory.Sym_[s] * moveFactory.Sym_[moveFactory.SymInv_[s]], moveFactory.Id_) << s;
+        // Conjugating a face turn by a symmetry gives a face turn again.
+        for (int m = 0; m < 18; ++m) {
+            auto c = moveFactory.conjugate(moveFactory.getMoveByName(static_cast<MoveName>(m)), s);
+            int found = 0;
+            for (int k = 0; k < 18; ++k) {
+                found += c == moveFactory.getMoveByName(static_cast<MoveName>(k));
+            }
+            EXPECT_EQ(found, 1) << s << " " << m;
+        }
+    }
+}
+
+// Exposes the block by block composition, which operator*= only uses without AVX2.
+struct ScalarCube : Cube::CubeStatus {
+    using Cube::CubeStatus::composeScalar;
+};
+
+TEST(CubeTest, PackedComposition) {
+    using namespace Cube;
+    auto &moveFactory = MoveFactory::getInstance();
+    EXPECT_EQ(sizeof(CubeStatus), 32);
+    for (int i = 0; i < 20; ++i) {
+        auto c = moveFactory.genRandomCube();
+        // Symmetries cover mirrored conor orientations on either side.
+        for (int s = 0; s < 48; ++s) {
+            for (const auto &[x, y] : {std::pair(c, moveFactory.Sym_[s]), std::pair(moveFactory.Sym_[s], c)}) {
+                ScalarCube expected;
+                static_cast<CubeStatus &>(expected) = x;
+                expected.composeScalar(y);
+                EXPECT_EQ(x * y, static_cast<CubeStatus &>(expected)) << i << " " << s;
+            }
+        }
+    }
+}
+
+TEST(CubeTest, UniformCube) {
+    using namespace Cube;
+    auto &solver = sharedSolver();
+    RandomFactory::Engine engine(42), same(42);
+    int oddConors = 0;
+    for (int i = 0; i < 200; ++i) {
+        auto c = MoveFactory::genUniformCube(engine);
+        EXPECT_EQ(c, MoveFactory::genUniformCube(same));
+        // Facelets::parse rejects unsolvable cubes.
+        EXPECT_EQ(Facelets::parse(Facelets::toString(c)), c);
+        int inversions = 0;
+        for (int x = BlockPos::URF; x <= BlockPos::DRB; ++x) {
+            for (int y = x + 1; y <= BlockPos::DRB; ++y) {
+                inversions += c.move_[x].pos() > c.move_[y].pos();
+            }
+        }
+        oddConors += inversions & 1;
+        if (i % 20 == 0) {
+            auto status = c;
+            for (auto m : solver.solve(c)) {
+                status = MoveFactory::getMoveByName(m) * status;
+            }
+            EXPECT_EQ(status, MoveFactory::Id_);
+        }
+    }
+    // Both parities are drawn about equally often.
+    EXPECT_GT(oddConors, 60);
+    EXPECT_LT(oddConors, 140);
+}
+
+TEST(CubeTest, CoordBatch) {
+    using namespace Cube;
+    std::vector<CubeStatus> cubes;
+    // Not a multiple of the cubes per register, so that the scalar tail runs as well.
+    for (int i = 0; i < 103; ++i) {
+        cubes.push_back(i % 2 == 0 ? MoveFactory::genUniformCube() : MoveFactory::getInstance().genRandomCube(i % 7));
+    }
+    CubeCoords coords;
+    coords.assign(cubes);
+    ASSERT_EQ(coords.size(), cubes.size());
+    std::vector<uint32_t> edgePerm(cubes.size());
+    CoordBatch::edgePerm(cubes, edgePerm.data());
+    for (size_t i = 0; i < cubes.size(); ++i) {
+        const auto &c = cubes[i];
+        EXPECT_EQ(coords.twist_[i], c.getConorOriCoord()) << i;
+        EXPECT_EQ(coords.flip_[i], c.getEdgeOriCoord()) << i;
+        EXPECT_EQ(coords.slice_[i], c.getUDSliceCoord()) << i;
+        EXPECT_EQ(coords.conorPerm_[i], c.getConorPermCoord()) << i;
+        EXPECT_EQ(coords.phase2EdgePerm_[i], c.getPhase2EdgePermCoord()) << i;
+        EXPECT_EQ(coords.sliceSorted_[i], c.getUDSliceSortedCoord()) << i;
+        EXPECT_EQ(edgePerm[i], c.getEdgePermCoord()) << i;
+
+        // Plain inversion count, which the popcount ranks replace.
+        uint64_t edgeRank = 0;
+        for (int j = BlockPos::BR; j > BlockPos::UR; --j) {
+            int s = 0;
+            for (int k = j - 1; k >= BlockPos::UR; --k) {
+                s += c.move_[k].pos() > c.move_[j].pos();
+            }
+            edgeRank = (edgeRank + s) * (j - BlockPos::UR);
+        }
+        EXPECT_EQ(edgePerm[i], edgeRank) << i;
+    }
+}
+
+TEST(CubeTest, Facelets) {
+    using namespace Cube;
+    const std::string solved = "UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBB";
+    EXPECT_EQ(Facelets::toString(MoveFactory::Id_), solved);
+    EXPECT_EQ(Facelets::parse(solved), MoveFactory::Id_);
+    EXPECT_EQ(Facelets::toString(MoveFactory::Moves_[U1]),
+              "UUUUUUUUUBBBRRRRRRRRRFFFFFFDDDDDDDDDFFFLLLLLLLLLBBBBBB");
+    for (int m = 0; m < 18; ++m) {
+        auto &c = MoveFactory::getMoveByName(static_cast<MoveName>(m));
+        EXPECT_EQ(Facelets::parse(Facelets::toString(c)), c) << m;
+    }
+    auto twisted = solved, flipped = solved, swapped = solved;
+    // Turn the URF corner, flip the UF edge, and swap the colors of two edges.
+    twisted[8] = 'R', twisted[9] = 'F', twisted[20] = 'U';
+    std::swap(flipped[7], flipped[19]);
+    std::swap(swapped[7], swapped[5]);
+    std::swap(swapped[19], swapped[10]);
+    for (const auto &bad : {std::string("UUU"), std::string(54, 'U'), twisted, flipped, swapped}) {
+        EXPECT_THROW(Facelets::parse(bad), std::invalid_argument) << bad;
+    }
+}
+
+TEST(CubeTest, Notation) {
+    using namespace Cube;
+    std::vector<MoveName> moves;
+    Notation::parseMoves("R U R' U'  F2 D3", moves);
+    EXPECT_EQ(moves, (std::vector<MoveName>{R1, U1, R3, U3, F2, D3}));
+    EXPECT_EQ(Notation::toString(moves), "R U R' U' F2 D'");
+    EXPECT_THROW(Notation::parseMoves("R X", moves), std::invalid_argument);
+}
+
+TEST(CubeTest, MoveSimplification) {
+    using namespace Cube;
+    EXPECT_EQ(MoveFactory::NextMoves_[MoveFactory::NoMove], (1u << 18) - 1);
+    // After U the other U turns are redundant, after D also the U turns, which commute with D.
+    EXPECT_EQ(std::popcount(MoveFactory::NextMoves_[U1]), 15);
+    EXPECT_EQ(std::popcount(MoveFactory::NextMoves_[D2]), 12);
+    EXPECT_TRUE(MoveFactory::NextMoves_[U1] >> D3 & 1);
+    EXPECT_FALSE(MoveFactory::NextMoves_[D1] >> U3 & 1);
+
+    auto simplify = [](const char *text) {
+        std::vector<MoveName> moves;
+        Notation::parseMoves(text, moves);
+        moves.resize(MoveFactory::simplifyMoves(moves.data(), static_cast<int>(moves.size())));
+        return Notation::toString(moves);
+    };
+    EXPECT_EQ(simplify("R R2"), "R'");
+    EXPECT_EQ(simplify("R L R'"), "L");
+    EXPECT_EQ(simplify("F B F"), "F2 B");
+    EXPECT_EQ(simplify("U D U' D'"), "");
+    EXPECT_EQ(simplify("R U U' R' F"), "F");
+    EXPECT_EQ(simplify("R U R' U'"), "R U R' U'");
+
+    auto &moveFactory = MoveFactory::getInstance();
+    auto &solver = sharedSolver();
+    for (int i = 0; i < 10; ++i) {
+        auto solution = solver.solve(moveFactory.genRandomCube());
+        ASSERT_FALSE(solution.empty());
+        auto copy = solution;
+        EXPECT_EQ(MoveFactory::simplifyMoves(copy.data(), static_cast<int>(copy.size())), solution.size());
+    }
+}
+
+TEST(CubeTest, StreamSolver) {
+    using namespace Cube;
+    auto &solver = sharedSolver();
+    ThreadPool pool(3);
+    // Small batches, so that batches finish out of order and the writer has to reorder them.
+    StreamSolver stream(solver, pool, {30, 2, 2});
+    RandomFactory::Engine engine(7);
+    std::vector<CubeStatus> cubes;
+    std::string input;
+    for (int i = 0; i < 40; ++i) {
+        cubes.push_back(MoveFactory::genUniformCube(engine));
+        input += Facelets::toString(cubes.back()) + "\n";
+    }
+    input += "\nR U2 F'\nnot a cube\r\n";
+
+    const std::string path = "stream_solver_test.txt";
+    std::ofstream(path, std::ios::binary) << input;
+    for (int source = 0; source < 2; ++source) {
+        std::istringstream in(input);
+        auto reader = source == 0 ? std::make_unique<LineReader>(in) : std::make_unique<LineReader>(path);
+        std::ostringstream out;
+        auto summary = stream.run(*reader, out);
+        EXPECT_EQ(summary.lines_, 43);
+        EXPECT_EQ(summary.errors_, 1);
+
+        std::istringstream lines(out.str());
+        std::string line;
+        for (const auto &cube : cubes) {
+            ASSERT_TRUE(std::getline(lines, line));
+            std::vector<MoveName> moves;
+            Notation::parseMoves(line, moves);
+            auto status = cube;
+            for (auto m : moves) {
+                status = MoveFactory::getMoveByName(m) * status;
+            }
+            EXPECT_EQ(status, MoveFactory::Id_) << line;
+        }
+        ASSERT_TRUE(std::getline(lines, line));
+        EXPECT_EQ(line, "");
+        ASSERT_TRUE(std::getline(lines, line));
+        EXPECT_EQ(line, Notation::toString(solver.solve(MoveFactory::Moves_[F3] * MoveFactory::Moves_[U2] *
+                                                        MoveFactory::Moves_[R1])));
+        ASSERT_TRUE(std::getline(lines, line));
+        EXPECT_EQ(line.rfind("error: ", 0), 0);
+        EXPECT_FALSE(std::getline(lines, line));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(CubeTest, Inverse) {
+    using namespace Cube;
+    for (int i = 0; i < 100; ++i) {
+        auto c = MoveFactory::genUniformCube();
+        EXPECT_EQ(c * c.inverse(), MoveFactory::Id_);
+        EXPECT_EQ(c.inverse() * c, MoveFactory::Id_);
+    }
+    // Mirrored conor orientations.
+    for (int s = 0; s < 48; ++s) {
+        EXPECT_EQ(MoveFactory::Sym_[s].inverse(), MoveFactory::Sym_[MoveFactory::SymInv_[s]]) << s;
+    }
+}
+
+TEST(CubeTest, SolutionCache) {
+    using namespace Cube;
+    auto &solver = sharedSolver();
+    SolutionCache cache(64);
+    RandomFactory::Engine engine(5);
+    auto solves = [](const CubeStatus &cube, const std::vector<MoveName> &solution) {
+        auto status = cube;
+        for (auto m : solution) {
+            status = MoveFactory::getMoveByName(m) * status;
+        }
+        return status == MoveFactory::Id_;
+    };
+    for (int i = 0; i < 8; ++i) {
+        auto cube = MoveFactory::genUniformCube(engine);
+        auto solution = cache.solve(solver, cube);
+        EXPECT_TRUE(solves(cube, solution));
+        // Every symmetric or inverse variant hits the entry, with a solution of the same length.
+        for (int s = 0; s < 48; s += 5) {
+            for (const auto &variant : {MoveFactory::conjugate(cube, s), MoveFactory::conjugate(cube.inverse(), s)}) {
+                std::vector<MoveName> hit;
+                ASSERT_TRUE(cache.lookup(variant, hit)) << i << " " << s;
+                EXPECT_EQ(hit.size(), solution.size());
+                EXPECT_TRUE(solves(variant, hit)) << i << " " << s;
+            }
+        }
+    }
+    EXPECT_EQ(cache.misses(), 8);
+
+    // Past its capacity the cache evicts, and what it keeps is still right.
+    SolutionCache small(4, 1);
+    std::vector<CubeStatus> cubes;
+    for (int i = 0; i < 12; ++i) {
+        cubes.push_back(MoveFactory::genUniformCube(engine));
+        auto moves = solver.solve(cubes.back());
+        small.insert(cubes.back(), moves.data(), static_cast<int>(moves.size()));
+    }
+    int kept = 0;
+    for (const auto &cube : cubes) {
+        std::vector<MoveName> hit;
+        if (small.lookup(cube, hit)) {
+            kept += 1;
+            EXPECT_TRUE(solves(cube, hit));
+        }
+    }
+    EXPECT_EQ(kept, 4);
+
+    // A longer solution never replaces a shorter one, whichever variant it comes from.
+    SolutionCache racing(16);
+    auto cube = MoveFactory::genUniformCube(engine);
+    auto shorter = solver.solve(cube);
+    auto longer = shorter;
+    longer.insert(longer.end(), {U1, U3});
+    racing.insert(cube, longer.data(), static_cast<int>(longer.size()));
+    racing.insert(cube, shorter.data(), static_cast<int>(shorter.size()));
+    auto inverseLonger = longer;
+    std::reverse(inverseLonger.begin(), inverseLonger.end());
+    for (auto &m : inverseLonger) {
+        m = static_cast<MoveName>(m / 3 * 3 + 2 - m % 3);
+    }
+    racing.insert(cube.inverse(), inverseLonger.data(), static_cast<int>(inverseLonger.size()));
+    std::vector<MoveName> hit;
+    ASSERT_TRUE(racing.lookup(MoveFactory::conjugate(cube, 7), hit));
+    EXPECT_EQ(hit.size(), shorter.size());
+    EXPECT_TRUE(solves(MoveFactory::conjugate(cube, 7), hit));
+}
+
+// Send lines to a connected socket and read back as many answer lines.
+static std::vector<std::string> roundTrip(int fd, const std::vector<std::string> &lines) {
+    std::string request;
+    for (const auto &line : lines) {
+        request += line + "\n";
+    }
+    EXPECT_EQ(::send(fd, request.data(), request.size(), MSG_NOSIGNAL), static_cast<ssize_t>(request.size()));
+    std::string received;
+    char buf[4096];
+    while (std::count(received.begin(), received.end(), '\n') < static_cast<long>(lines.size())) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        received.append(buf, static_cast<size_t>(n));
+    }
+    std::vector<std::string> answers;
+    std::istringstream in(received);
+    for (std::string line; std::getline(in, line);) {
+        answers.push_back(line);
+    }
+    return answers;
+}
+
+TEST(CubeTest, SolveServer) {
+    using namespace Cube;
+    auto &solver = sharedSolver();
+    ThreadPool pool(3);
+    SolveServer server(solver, pool);
+    const std::string path = "solve_server_test.sock";
+    server.listenUnix(path);
+    SolveServer tcpServer(solver, pool);
+    uint16_t port = tcpServer.listenTcp(0);
+
+    RandomFactory::Engine engine(11);
+    std::vector<CubeStatus> cubes;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 16; ++i) {
+        cubes.push_back(MoveFactory::genUniformCube(engine));
+        lines.push_back(Facelets::toString(cubes.back()));
+    }
+    lines.emplace_back("R U2 X");
+
+    // Several clients at once, so that requests of different connections share batches.
+    std::vector<std::thread> clients;
+    for (int c = 0; c < 4; ++c) {
+        clients.emplace_back([&, c] {
+            int fd;
+            if (c % 2 == 0) {
+                fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un addr{};
+                addr.sun_family = AF_UNIX;
+                std::strcpy(addr.sun_path, path.c_str());
+                ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+            } else {
+                fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(port);
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+            }
+            auto answers = roundTrip(fd, lines);
+            ::close(fd);
+            ASSERT_EQ(answers.size(), lines.size());
+            for (size_t i = 0; i < cubes.size(); ++i) {
+                auto tab = answers[i].find('\t');
+                ASSERT_NE(tab, std::string::npos) << answers[i];
+                EXPECT_NE(answers[i].find("nodes=", tab), std::string::npos);
+                EXPECT_NE(answers[i].find("batch=", tab), std::string::npos);
+                std::vector<MoveName> moves;
+                Notation::parseMoves(std::string_view(answers[i]).substr(0, tab), moves);
+                auto status = cubes[i];
+                for (auto m : moves) {
+                    status = MoveFactory::getMoveByName(m) * status;
+                }
+                EXPECT_EQ(status, MoveFactory::Id_) << answers[i];
+            }
+            EXPECT_EQ(answers.back().rfind("error: ", 0), 0);
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    server.stop();
+    tcpServer.stop();
+    EXPECT_EQ(server.answered() + tcpServer.answered(), 4 * lines.size());
+    EXPECT_NE(::access(path.c_str(), F_OK), 0);
+}
+
+TEST(CubeTest, SolveServerSlowClient) {
+    using namespace Cube;
+    auto &solver = sharedSolver();
+    ThreadPool pool(3);
+    SolveServer::Options options;
+    options.maxPendingBytes_ = 64 << 10;
+    options.sendTimeout_ = 0.5;
+    SolveServer server(solver, pool, options);
+    const std::string path = "solve_server_slow_test.sock";
+    server.listenUnix(path);
+    auto connectClient = [&] {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, path.c_str());
+        EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+        // Fail rather than hang if the server stalls.
+        timeval timeout{5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        return fd;
+    };
+
+    // Megabytes of answers for a client which never reads them, requested before the other client.
+    int slow = connectClient();
+    std::string flood;
+    for (int i = 0; i < 100000; ++i) {
+        flood += "X\n";
+    }
+    ::send(slow, flood.data(), flood.size(), MSG_NOSIGNAL);
+    // Let the server get into the flood, so that the other requests queue behind the rest of it.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (server.answered() < 4096 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    RandomFactory::Engine engine(13);
+    std::vector<CubeStatus> cubes;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 8; ++i) {
+        cubes.push_back(MoveFactory::genUniformCube(engine));
+        lines.push_back(Facelets::toString(cubes.back()));
+    }
+    int fd = connectClient();
+    auto answers = roundTrip(fd, lines);
+    ::close(fd);
+    ::close(slow);
+    server.stop();
+    ASSERT_EQ(answers.size(), lines.size());
+    for (size_t i = 0; i < cubes.size(); ++i) {
+        auto tab = answers[i].find('\t');
+        ASSERT_NE(tab, std::string::npos) << answers[i];
+        std::vector<MoveName> moves;
+        Notation::parseMoves(std::string_view(answers[i]).substr(0, tab), moves);
+        auto status = cubes[i];
+        for (auto m : moves) {
+            status = MoveFactory::getMoveByName(m) * status;
+        }
+        EXPECT_EQ(status, MoveFactory::Id_) << answers[i];
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, FlipSliceSymTable) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        EXPECT_EQ(*std::max_element(solver.FlipSliceClassIdx_, solver.FlipSliceClassIdx_ + TwoPhaseSolver::FlipSliceCnt),
+                  TwoPhaseSolver::FlipSliceClassCnt - 1);
+        for (int i = 0; i < 50; ++i) {
+            auto status = solver.moveFactory.genRandomCube();
+            auto twist = static_cast<uint16_t>(status.getConorOriCoord());
+            auto flip = static_cast<uint16_t>(status.getEdgeOriCoord());
+            auto slice = static_cast<uint16_t>(status.getUDSliceCoord());
+            uint32_t flipSlice = slice * TwoPhaseSolver::FlipCnt + flip;
+            auto rep = solver.moveFactory.conjugate(status, solver.FlipSliceSym_[flipSlice]);
+            EXPECT_EQ(rep.getUDSliceCoord() * TwoPhaseSolver::FlipCnt + rep.getEdgeOriCoord(),
+                      solver.FlipSliceRep_[solver.FlipSliceClassIdx_[flipSlice]]);
+            EXPECT_EQ(rep.getConorOriCoord(), solver.TwistConj_[twist][solver.FlipSliceSym_[flipSlice]]);
+
+            // Symmetric positions are equally far from G1.
+            auto depth = solver.phaseOneSearch(status).size();
+            for (int s = 0; s < TwoPhaseSolver::SymCnt; ++s) {
+                EXPECT_EQ(solver.phaseOneSearch(solver.moveFactory.conjugate(status, s)).size(), depth);
+            }
+        }
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, TableFile) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        // The shared solver either mapped the file or wrote it after building.
+        TwoPhaseSolver loaded(TablePath);
+        EXPECT_TRUE(loaded.tablesMapped());
+        auto layout = solver.tableLayout();
+        for (uint32_t i = 0; i < layout.size(); ++i) {
+            EXPECT_EQ(std::memcmp(solver.tables_.section(i), loaded.tables_.section(i), layout[i]), 0) << i;
+        }
+
+        EXPECT_TRUE(loaded.tables_.verify());
+
+        // A corrupted file maps, but fails verification.
+        std::string corruptPath = TablePath + ".corrupt";
+        {
+            std::ifstream in(TablePath, std::ios::binary);
+            std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            bytes[bytes.size() / 2] ^= 1;
+            std::ofstream out(corruptPath, std::ios::binary);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        auto corrupt = TableStorage::map(corruptPath, layout);
+        ASSERT_FALSE(corrupt.empty());
+        EXPECT_FALSE(corrupt.verify());
+        EXPECT_FALSE(TableStorage::map(TablePath, layout).empty());
+
+        // A file of another format version is rejected.
+        {
+            std::fstream file(corruptPath, std::ios::binary | std::ios::in | std::ios::out);
+            uint32_t version = TableStorage::Version + 1;
+            file.seekp(8);
+            file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        }
+        EXPECT_TRUE(TableStorage::map(corruptPath, layout).empty());
+        layout.pop_back();
+        EXPECT_TRUE(TableStorage::map(TablePath, layout).empty());
+        std::remove(corruptPath.c_str());
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, NumaPlacement) {
+        using namespace Cube;
+        auto &moveFactory = MoveFactory::getInstance();
+        auto &numa = NumaTopology::get();
+        ASSERT_GE(numa.nodeCnt(), 1);
+        for (int node = 0; node < numa.nodeCnt(); ++node) {
+            EXPECT_FALSE(numa.cpus(node).empty()) << node;
+        }
+
+        // Pinned workers report their own node.
+        ThreadPool pool(4, true);
+        std::vector<int> nodes(64, -1);
+        pool.parallelFor(nodes.size(), 1, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                nodes[i] = numa.currentNode();
+            }
+        });
+        for (int node : nodes) {
+            EXPECT_GE(node, 0);
+            EXPECT_LT(node, numa.nodeCnt());
+        }
+
+        auto &shared = sharedSolver();
+        auto layout = shared.tableLayout();
+        std::vector<CubeStatus> cubes;
+        for (int i = 0; i < 8; ++i) {
+            cubes.push_back(moveFactory.genRandomCube());
+        }
+        for (auto policy : {TwoPhaseSolver::NumaPolicy::Interleave, TwoPhaseSolver::NumaPolicy::Replicate}) {
+            TwoPhaseSolver solver(TablePath);
+            solver.placeTables(policy);
+            const auto &local = solver.local();
+            EXPECT_FALSE(local.tablesMapped());
+            EXPECT_EQ(solver.replicas_.size(),
+                      policy == TwoPhaseSolver::NumaPolicy::Replicate ? static_cast<size_t>(numa.nodeCnt()) : 0);
+            for (uint32_t i = 0; i < layout.size(); ++i) {
+                EXPECT_EQ(std::memcmp(shared.tables_.section(i), local.tables_.section(i), layout[i]), 0) << i;
+            }
+            auto solutions = solver.solveBatch(cubes, pool);
+            for (size_t i = 0; i < cubes.size(); ++i) {
+                EXPECT_EQ(solutions[i], shared.solve(cubes[i])) << i;
+            }
+        }
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, OptimalSolver) {
+        using namespace Cube;
+        auto &moveFactory = MoveFactory::getInstance();
+        std::string path = TablePath + ".optimal";
+        std::remove(path.c_str());
+        {
+            OptimalSolver built(sharedSolver(), path);
+            EXPECT_FALSE(built.tablesMapped());
+        }
+        OptimalSolver solver(sharedSolver(), path);
+        EXPECT_TRUE(solver.tablesMapped());
+        // Over replicated tables, the search reads the replica of its node.
+        TwoPhaseSolver replicated(TablePath);
+        replicated.placeTables(TwoPhaseSolver::NumaPolicy::Replicate);
+        OptimalSolver onReplica(replicated, path);
+        std::remove(path.c_str());
+        // Classes are numbered by their smallest member, so every class has been reached.
+        EXPECT_EQ(solver.ConorPermRep_[0], 0);
+        EXPECT_GT(solver.ConorPermRep_[OptimalSolver::ConorPermClassCnt - 1], 0);
+
+        EXPECT_TRUE(solver.solve(moveFactory.Id_).solution_.empty());
+        // Sune is known to take 7 moves.
+        auto sune = moveFactory.Id_;
+        for (auto m : {R1, U1, R3, U1, R1, U2, R3}) {
+            sune = moveFactory.getMoveByName(m) * sune;
+        }
+        EXPECT_EQ(solver.solve(sune).solution_.size(), 7);
+
+        for (int i = 0; i < 5; ++i) {
+            auto status = moveFactory.genRandomCube(9);
+            auto res = solver.solve(status);
+            EXPECT_LE(res.solution_.size(), 9);
+            EXPECT_GT(res.stats_.totalNodes(), 0);
+            // Symmetric cubes and the inverse are exactly as far from solved.
+            EXPECT_EQ(solver.solve(status.inverse()).solution_.size(), res.solution_.size());
+            EXPECT_EQ(solver.solve(MoveFactory::conjugate(status, 16 + i)).solution_.size(), res.solution_.size());
+            EXPECT_EQ(onReplica.solve(status).solution_, res.solution_);
+            for (auto m : res.solution_) {
+                status = moveFactory.getMoveByName(m) * status;
+            }
+            EXPECT_EQ(status, moveFactory.Id_);
+        }
+    }
+}
+
+TEST(CubeTest, ThreadPool) {
+    using namespace Cube;
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> hits(100003);
+    pool.parallelFor(hits.size(), 1000, [&hits](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            hits[i] += 1;
+        }
+    });
+    for (auto &h : hits) {
+        EXPECT_EQ(h, 1);
+    }
+}
+
+TEST(CubeTest, ThreadPoolException) {
+    using namespace Cube;
+    // Thrown on some thread of the pool, or on the calling thread alone without workers.
+    for (unsigned workers : {4u, 0u}) {
+        ThreadPool pool(workers);
+        std::atomic<int> started{0};
+        auto throwing = [&started](uint64_t begin, uint64_t) {
+            started += 1;
+            if (begin % 7 == 3) {
+                throw std::runtime_error("chunk failed");
+            }
+        };
+        EXPECT_THROW(pool.parallelFor(1000, 1, throwing), std::runtime_error);
+        EXPECT_LT(started.load(), 1000);
+
+        // The pool stays usable.
+        std::atomic<uint64_t> sum{0};
+        pool.parallelFor(100, 1, [&sum](uint64_t begin, uint64_t) { sum += begin; });
+        EXPECT_EQ(sum.load(), 4950);
+    }
+}
+
+namespace Cube {
+    TEST(CubeTest, ParallelPruningTable) {
+        using namespace Cube;
+        auto &solver = sharedSolver();
+        ThreadPool pool(8);
+        uint64_t cnt = TwoPhaseSolver::Phase2EdgePermCnt * TwoPhaseSolver::SlicePermCnt;
+        std::vector<uint64_t> data(PruningTable::byteSize(cnt) / sizeof(uint64_t));
+        PruningTable table(data.data(), cnt);
+        table.build(pool, [&solver](uint64_t idx, auto &&visit) { solver.edgePermSliceNeighbours(idx, visit); });
+        for (uint64_t idx = 0; idx < cnt; ++idx) {
+            EXPECT_EQ(table.get(idx), solver.EdgePermSliceHeuristic_.get(idx));
+        }
+    }
+}
@@ -0,0 +1,341 @@
+#ifndef CUBE_SOLVER_THREAD_POOL_H
+#define CUBE_SOLVER_THREAD_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <limits>
+#include <exception>
+
+#include "numa.h"
+
+namespace Cube {
+
+    //**********************************************************************
+    // Declarations
+    //**********************************************************************
+
+    class ThreadPool {
+    public:
+        // Default worker count, one per hardware thread.
+        static constexpr unsigned HardwareThreads = std::numeric_limits<unsigned>::max();
+
+        // threadCnt = 0 starts no workers, so that parallelFor runs on the calling thread alone.
+        explicit ThreadPool(unsigned threadCnt = HardwareThreads);
+
+        // With pinToNodes, the workers are pinned to the NUMA nodes in equal shares.
+        ThreadPool(unsigned threadCnt, bool pinToNodes);
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        void operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool();
+
+        unsigned size() const;
+
+        // Run f(begin, end) over [0, n) in chunks of at most chunk indices on all threads, the calling one
+        // included, and return once every chunk is done.
+        //
+        // Each thread starts on its own contiguous share of the chunks. A thread running out of work steals
+        // the back half of another thread's remaining chunks, so a few slow chunks do not leave the other
+        // threads idle, while consecutive chunks mostly stay on one thread.
+        //
+        // If f throws, no further chunks are started, and the first exception is rethrown on the calling
+        // thread once all threads have left f.
+        template<typename F>
+        void parallelFor(uint64_t n, uint64_t chunk, F f);
+
+    protected:
+        // Chunks [begin, end) not yet started by one thread, packed as begin << 32 | end so that the owner
+        // taking the front and thieves taking the back agree through a single compare-and-swap.
+        struct alignas(64) StealRange {
+            std::atomic<uint64_t> bounds_{0};
+
+            void reset(uint64_t begin, uint64_t end);
+
+            bool popFront(uint64_t &chunk);
+
+            // Move the back half of this range into thief, which must be empty.
+            bool stealInto(StealRange &thief);
+        };
+
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+
+        void submit(std::function<void()> task);
+
+        void workerLoop();
+    };
+
+    /*
+     * Queue between threads holding at most capacity items, so that a fast producer waits for its consumers
+     * instead of buffering without bound. Once closed, push fails and pop drains the remaining items.
+     * */
+    template<typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity);
+
+        BoundedQueue(const BoundedQueue &) = delete;
+
+        void operator=(const BoundedQueue &) = delete;
+
+        // Wait for room, returning false if the queue was closed meanwhile.
+        bool push(T item);
+
+        // Wait for an item, returning false once the queue is closed and empty.
+        bool pop(T &item);
+
+        // Wait for an item, then append it and those queued behind it, at most max in total, to items.
+        // Returns the number appended, 0 once the queue is closed and empty.
+        size_t popMany(std::vector<T> &items, size_t max);
+
+        void close();
+
+    protected:
+        size_t capacity_;
+        std::deque<T> items_;
+        std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::condition_variable notFull_;
+        bool closed_ = false;
+    };
+
+    //**********************************************************************
+    // Implementations
+    //**********************************************************************
+
+    ThreadPool::ThreadPool(unsigned threadCnt) : ThreadPool(threadCnt, false) {}
+
+    ThreadPool::ThreadPool(unsigned threadCnt, bool pinToNodes) {
+        if (threadCnt == HardwareThreads) {
+            threadCnt = std::max(1u, std::thread::hardware_concurrency());
+        }
+        auto nodeCnt = static_cast<unsigned>(NumaTopology::get().nodeCnt());
+        for (unsigned i = 0; i < threadCnt; ++i) {
+            int node = pinToNodes ? static_cast<int>(i * nodeCnt / threadCnt) : -1;
+            workers_.emplace_back([this, node] {
+                if (node >= 0) {
+                    NumaTopology::get().pinThread(node);
+                }
+                workerLoop();
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &w : workers_) {
+            w.join();
+        }
+    }
+
+    unsigned ThreadPool::size() const {
+        return static_cast<unsigned>(workers_.size());
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    void ThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    void ThreadPool::StealRange::reset(uint64_t begin, uint64_t end) {
+        bounds_.store(begin << 32 | end, std::memory_order_relaxed);
+    }
+
+    bool ThreadPool::StealRange::popFront(uint64_t &chunk) {
+        uint64_t bounds = bounds_.load(std::memory_order_relaxed);
+        while ((bounds >> 32) < (bounds & 0xffffffffULL)) {
+            if (bounds_.compare_exchange_weak(bounds, bounds + (1ULL << 32), std::memory_order_relaxed)) {
+                chunk = bounds >> 32;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ThreadPool::StealRange::stealInto(StealRange &thief) {
+        uint64_t bounds = bounds_.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t begin = bounds >> 32, end = bounds & 0xffffffffULL;
+            if (begin >= end) {
+                return false;
+            }
+            uint64_t mid = end - (end - begin + 1) / 2;
+            if (bounds_.compare_exchange_weak(bounds, begin << 32 | mid, std::memory_order_relaxed)) {
+                thief.reset(mid, end);
+                return true;
+            }
+        }
+    }
+
+    template<typename F>
+    void ThreadPool::parallelFor(uint64_t n, uint64_t chunk, F f) {
+        uint64_t chunkCnt = (n + chunk - 1) / chunk;
+        if (chunkCnt == 0) {
+            return;
+        }
+        if (chunkCnt > 0xffffffffULL) {
+            throw std::runtime_error(std::string(__func__) + ": too many chunks");
+        }
+        auto threadCnt = static_cast<unsigned>(std::min<uint64_t>(size() + 1, chunkCnt));
+        std::vector<StealRange> ranges(threadCnt);
+        for (unsigned t = 0; t < threadCnt; ++t) {
+            ranges[t].reset(chunkCnt * t / threadCnt, chunkCnt * (t + 1) / threadCnt);
+        }
+
+        std::mutex doneMutex;
+        std::condition_variable doneCv;
+        unsigned running = threadCnt - 1;
+        // First exception thrown, set under doneMutex.
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+        auto fail = [&](std::exception_ptr e) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (!error) {
+                error = std::move(e);
+            }
+            failed.store(true, std::memory_order_relaxed);
+        };
+
+        auto run = [&](unsigned self) {
+            try {
+                while (!failed.load(std::memory_order_relaxed)) {
+                    uint64_t c;
+                    while (!failed.load(std::memory_order_relaxed) && ranges[self].popFront(c)) {
+                        f(c * chunk, std::min(n, (c + 1) * chunk));
+                    }
+                    bool stolen = false;
+                    for (unsigned k = 1; k < threadCnt && !stolen; ++k) {
+                        stolen = ranges[(self + k) % threadCnt].stealInto(ranges[self]);
+                    }
+                    // Chunks being moved by a thief are invisible here, but that thief runs them.
+                    if (!stolen) {
+                        return;
+                    }
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        };
+
+        for (unsigned t = 0; t + 1 < threadCnt; ++t) {
+            try {
+                submit([&, t] {
+                    run(t);
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    if (--running == 0) {
+                        doneCv.notify_one();
+                    }
+                });
+            } catch (...) {
+                // The tasks not submitted never finish, and the chunks they own are not run.
+                fail(std::current_exception());
+                std::lock_guard<std::mutex> lock(doneMutex);
+                running -= threadCnt - 1 - t;
+                break;
+            }
+        }
+        run(threadCnt - 1);
+        // The workers use the locals above, so they are waited for even if f threw.
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCv.wait(lock, [&running] { return running == 0; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    template<typename T>
+    BoundedQueue<T>::BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    template<typename T>
+    bool BoundedQueue<T>::push(T item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(item));
+        }
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    template<typename T>
+    bool BoundedQueue<T>::pop(T &item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+            if (items_.empty()) {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+        }
+        notFull_.notify_one();
+        return true;
+    }
+
+    template<typename T>
+    size_t BoundedQueue<T>::popMany(std::vector<T> &items, size_t max) {
+        size_t cnt = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+            for (; cnt < max && !items_.empty(); ++cnt) {
+                items.push_back(std::move(items_.front()));
+                items_.pop_front();
+            }
+        }
+        notFull_.notify_all();
+        return cnt;
+    }
+
+    template<typename T>
+    void BoundedQueue<T>::close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+}
+
+#endif //CUBE_SOLVER_THREAD_POOL_H
@@ -2,11 +2,23 @@
 #define CUBE_SOLVER_TWO_PHASE_SOLVER_H
 
 #include <cstdint>
+#include <bit>
 #include <vector>
+#include <algorithm>
+#include <span>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
 #include <gtest/gtest.h>
 
 #include "cube_def.h"
 #include "utility.h"
+#include "pruning_table.h"
+#include "table_file.h"
+#include "thread_pool.h"
+#include "search_stats.h"
+#include "coord_batch.h"
 
 namespace Cube {
 
@@ -16,76 +28,1250 @@ namespace Cube {
 
     class TwoPhaseSolver {
     public:
+        // Every cube can be brought into G1 = <U, D, L2, R2, F2, B2> within 12 moves.
+        static constexpr int MaxPhaseOneDepth = 12;
+        // Every cube in G1 can be solved within 18 moves of G1.
+        static constexpr int MaxPhaseTwoDepth = 18;
+
+        // Build all tables in memory.
         TwoPhaseSolver();
 
-        std::vector<BasicMoveName> phaseOneSearch(const CubeStatus &start);
+        // Map the tables from the table file at tablePath. If it is missing or stale, build the tables and
+        // write the file for the next process.
+        explicit TwoPhaseSolver(const std::string &tablePath);
+
+        // Whether the tables are shared read-only with other processes through a table file.
+        bool tablesMapped() const;
+
+        // Placement of the tables on hosts with several NUMA nodes, see placeTables.
+        enum class NumaPolicy {
+            // Tables stay where they are, shared with other processes if mapped from a table file.
+            Shared,
+            // A private copy with its pages spread evenly over all nodes.
+            Interleave,
+            // A private copy on every node. Searches use the copy of the node their thread runs on, so
+            // threads pinned to nodes, see ThreadPool, only read local memory.
+            Replicate
+        };
+
+        // Copy the tables into private memory placed by policy. Must not run concurrently with searches.
+        void placeTables(NumaPolicy policy);
+
+        // Shortest move sequence bringing start into G1 = <U, D, L2, R2, F2, B2>.
+        std::vector<MoveName> phaseOneSearch(const CubeStatus &start) const;
+
+        // Shortest move sequence of G1 moves solving start, which must be in G1.
+        std::vector<MoveName> phaseTwoSearch(const CubeStatus &start) const;
+
+        // Solve start with at most maxLength moves, returning an empty vector if no solution is found.
+        std::vector<MoveName> solve(const CubeStatus &start, int maxLength = 30) const;
+
+        // Phase 2 coordinates after each move of the phase one path which last entered phase two. The
+        // phase one solutions of a search share most of their moves, so entering phase two only looks up
+        // the moves after the shared prefix, see phaseTwoAfter.
+        struct PhaseTwoEntry {
+            MoveName path_[MaxPhaseOneDepth];
+            // Coordinates after the first i moves of path_, for i up to valid_.
+            uint16_t conorPerm_[MaxPhaseOneDepth + 1];
+            uint16_t sliceSorted_[MaxPhaseOneDepth + 1];
+            uint16_t uEdges_[MaxPhaseOneDepth + 1];
+            uint16_t dEdges_[MaxPhaseOneDepth + 1];
+            int valid_ = 0;
+
+            // Start over with the coordinates of start and an empty path.
+            void reset(const CubeStatus &start);
+        };
+
+        // Move stacks of a solve. The search keeps everything else on the call stack, so solving with a
+        // reused context does not touch the heap.
+        struct SearchContext {
+            MoveName phaseOnePath_[MaxPhaseOneDepth];
+            MoveName phaseTwoPath_[MaxPhaseTwoDepth];
+            MoveName solution_[MaxPhaseOneDepth + MaxPhaseTwoDepth];
+            PhaseTwoEntry phaseTwoEntry_;
+            // Length of solution_, or -1 if the last solve found none.
+            int length_ = -1;
+        };
+
+        // Solve start into context.solution_, returning whether a solution was found.
+        bool solve(const CubeStatus &start, SearchContext &context, int maxLength = 30) const;
+
+        struct SolveResult {
+            std::vector<MoveName> solution_;
+            SearchStats stats_;
+        };
+
+        // Solve like solve(), also counting the work done by the search.
+        SolveResult solveWithStats(const CubeStatus &start, int maxLength = 30) const;
+
+        // Limits of solveAnytime. Zero seconds or nodes means no limit.
+        struct SolveBudget {
+            int targetLength_ = 20;
+            int maxLength_ = 30;
+            double seconds_ = 0;
+            // Nodes of both phases.
+            uint64_t nodes_ = 0;
+        };
+
+        // Keep searching longer phase one solutions for ever shorter solutions, until one of at most
+        // targetLength_ moves is found, no shorter one exists or the budget runs out. Returns the shortest
+        // solution found, which is empty if the budget runs out before the first one.
+        SolveResult solveAnytime(const CubeStatus &start, const SolveBudget &budget) const;
+
+        // Solve every cube of cubes on pool, returning the solutions in input order. The searches only read
+        // the tables, so all threads share this solver. Threads which run out of cubes steal the remaining
+        // ones of others, so a few hard cubes do not hold up the batch.
+        std::vector<std::vector<MoveName>> solveBatch(std::span<const CubeStatus> cubes, ThreadPool &pool,
+                                                      int maxLength = 30) const;
+
+        // Solve a single cube like solve(), with each phase one depth split into the subtrees below its
+        // first two moves, which are searched concurrently on pool. The first solution found stops the
+        // other subtrees, and solutions finished meanwhile only replace it if they are shorter, so the
+        // result may differ from solve().
+        std::vector<MoveName> solveParallel(const CubeStatus &start, ThreadPool &pool, int maxLength = 30) const;
+
+        // Number of searches of solveRacing: three axes as U/D, each for the cube and for its inverse.
+        static constexpr int RaceCnt = 6;
 
-        std::vector<BasicMoveName> phaseTwoSearch(const CubeStatus &start);
+        // solveAnytime of the cube turned so that each of the three axes is U/D, and of its inverse turned
+        // likewise, run concurrently on pool. The searches share the length of the shortest solution found
+        // so far as their bound, and the budget covers them all. The shortest solution is mapped back to
+        // start, and the stats are summed over the searches.
+        SolveResult solveRacing(const CubeStatus &start, ThreadPool &pool, const SolveBudget &budget) const;
 
     protected:
+        // Shares the phase one tables.
+        friend class OptimalSolver;
+
+        static constexpr int TwistCnt = 2187;
+        static constexpr int FlipCnt = 2048;
         static constexpr int UDSliceCnt = 495;
+        static constexpr int ConorPermCnt = 40320;
+        static constexpr int Phase2EdgePermCnt = 40320;
+        static constexpr int SlicePermCnt = 24;
+        // Positions and order of four edges, see CubeStatus::getUEdgesCoord. Below Phase2UDEdgesCnt in G1.
+        static constexpr int UDEdgesCnt = 11880;
+        static constexpr int Phase2UDEdgesCnt = 1680;
+        static constexpr int MoveCnt = 18;
+        static constexpr int Phase2MoveCnt = 10;
+
+        // Sym_[0..16) of MoveFactory are the D4h symmetries, which keep the UD axis and so G1.
+        static constexpr int SymCnt = 16;
+        static constexpr int FlipSliceCnt = FlipCnt * UDSliceCnt;
+        static constexpr int FlipSliceClassCnt = 64430;
+
+        static constexpr MoveName Phase1Moves[MoveCnt] = {U1, U2, U3, D1, D2, D3, F1, F2, F3,
+                                                          B1, B2, B3, L1, L2, L3, R1, R2, R3};
+        static constexpr MoveName Phase2Moves[Phase2MoveCnt] = {U1, U2, U3, D1, D2, D3, F2, B2, L2, R2};
+
+        // All tables live in tables_, see forEachTable.
+        TableStorage tables_;
+
+        // Solvers with copies of the tables by NUMA node for NumaPolicy::Replicate, else empty.
+        std::vector<std::unique_ptr<TwoPhaseSolver>> replicas_;
 
-        uint32_t UDSliceHeuristic_[UDSliceCnt];
-        uint32_t UDSliceMoveTable_[UDSliceCnt][18]; // 18 is the number of all basic moves.
+        uint16_t (*TwistMoveTable_)[MoveCnt] = nullptr;
+        uint16_t (*FlipMoveTable_)[MoveCnt] = nullptr;
+        // The small move tables are computed at compile time, see makeCoordMoveTable.
+        static const std::array<std::array<uint16_t, MoveCnt>, UDSliceCnt> UDSliceMoveTable_;
         FRIEND_TEST(CubeTest, UDSliceMoveTable);
+        FRIEND_TEST(CubeTest, CompileTimeTables);
+        FRIEND_TEST(CubeTest, PhaseOneMoveTable);
+
+        // Phase 2 tables are indexed by the position in Phase2Moves.
+        uint16_t (*ConorPermMoveTable_)[Phase2MoveCnt] = nullptr;
+        uint16_t (*Phase2EdgePermMoveTable_)[Phase2MoveCnt] = nullptr;
+        static const std::array<std::array<uint8_t, Phase2MoveCnt>, SlicePermCnt> SlicePermMoveTable_;
+        FRIEND_TEST(CubeTest, PhaseTwoMoveTable);
+        // MoveFactory::NextMoves_ by the position in Phase2Moves.
+        static const std::array<uint16_t, MoveFactory::NoMove + 1> Phase2NextMoves_;
+
+        // Phase 2 coordinates under all moves, which carry them along phase one paths, see PhaseTwoEntry.
+        // The U and D edges give the phase 2 edge permutation as Phase2EdgeMerge_[uEdges][dEdges % 24].
+        uint16_t (*ConorPermFullMoveTable_)[MoveCnt] = nullptr;
+        uint16_t (*UDSliceSortedMoveTable_)[MoveCnt] = nullptr;
+        uint16_t (*UEdgesMoveTable_)[MoveCnt] = nullptr;
+        uint16_t (*DEdgesMoveTable_)[MoveCnt] = nullptr;
+        uint16_t (*Phase2EdgeMerge_)[SlicePermCnt] = nullptr;
+        FRIEND_TEST(CubeTest, PhaseTwoEntry);
+
+        // Flipslice symmetry classes. The raw flipslice coordinate is slice * FlipCnt + flip, and
+        // conjugating a raw coordinate fs by FlipSliceSym_[fs] gives the representative of its class.
+        uint16_t *FlipSliceClassIdx_ = nullptr;
+        uint8_t *FlipSliceSym_ = nullptr;
+        uint32_t *FlipSliceRep_ = nullptr;
+        // Bitmask of symmetries which leave the representative of a class unchanged.
+        uint16_t *FlipSliceSelfSym_ = nullptr;
+        // Twist of the conjugate by each symmetry.
+        uint16_t (*TwistConj_)[SymCnt] = nullptr;
+        FRIEND_TEST(CubeTest, FlipSliceSymTable);
+
+        // Phase 1 heuristic, indexed by flipslice class * TwistCnt + twist conjugated into the class.
+        PruningTable FlipSliceTwistHeuristic_;
+        // Phase 2 heuristics, indexed by perm * SlicePermCnt + slicePerm.
+        PruningTable ConorPermSliceHeuristic_;
+        PruningTable EdgePermSliceHeuristic_;
+        FRIEND_TEST(CubeTest, PruningTable);
+        FRIEND_TEST(CubeTest, ParallelPruningTable);
+        FRIEND_TEST(CubeTest, TableFile);
+        FRIEND_TEST(CubeTest, NumaPlacement);
 
 
         ConstantFactory &constantFactory = ConstantFactory::getInstance();
         MoveFactory &moveFactory = MoveFactory::getInstance();
 
-        void buildMoveTable();
+        // Call visit(table, cnt) for every table member with its number of entries, in file order.
+        template<typename Visit>
+        void forEachTable(Visit visit);
+
+        // Byte size of each table, in the order of forEachTable.
+        std::vector<uint64_t> tableLayout();
+
+        // Point every table member at its section of tables_.
+        void bindTables();
+
+        // Solver with a copy of the tables of other placed on node, see placeTables.
+        TwoPhaseSolver(const TwoPhaseSolver &other, int node);
+
+        // The replica of the calling thread's node, or this solver without replicas.
+        const TwoPhaseSolver &local() const;
+
+        void buildTables();
+
+        void buildMoveTable(ThreadPool &pool);
+
+        void buildHeuristic(ThreadPool &pool);
+
+        void buildSymTable(ThreadPool &pool);
 
-        void buildHeuristic();
+        void buildFlipSliceSymTable();
 
-        void buildUdSliceMoveTable();
+        void buildTwistConjTable(ThreadPool &pool);
 
-        void buildUDSliceHeuristic();
+        void buildTwistMoveTable(ThreadPool &pool);
+
+        void buildFlipMoveTable(ThreadPool &pool);
+
+        void buildConorPermMoveTable(ThreadPool &pool);
+
+        void buildPhase2EdgePermMoveTable(ThreadPool &pool);
+
+        void buildPhaseTwoEntryTables(ThreadPool &pool);
+
+        void buildFlipSliceTwistHeuristic(ThreadPool &pool);
+
+        void buildConorPermSliceHeuristic(ThreadPool &pool);
+
+        void buildEdgePermSliceHeuristic(ThreadPool &pool);
+
+        // Fill table[coord][k] with the coordinate reached by applying moves[k] to the cube getBy(coord).
+        // getCoords(cubes, out) is a kernel of CoordBatch, which takes the cubes of a row at once.
+        template<typename MoveTable, size_t N, typename GetBy, typename GetCoords>
+        void buildCoordMoveTable(ThreadPool &pool, MoveTable &table, int cnt, const MoveName (&moves)[N],
+                                 GetBy getBy, GetCoords getCoords);
+
+        // Compile time version of buildCoordMoveTable.
+        template<typename Entry, size_t Cnt, size_t N, typename GetBy, typename GetCoord>
+        static constexpr std::array<std::array<Entry, N>, Cnt> makeCoordMoveTable(const MoveName (&moves)[N],
+                                                                                 GetBy getBy, GetCoord getCoord);
+
+        // UDSliceMoveTable_, moving bitmasks of the slice edges rather than cubes, which the compiler
+        // evaluates far slower.
+        static constexpr std::array<std::array<uint16_t, MoveCnt>, UDSliceCnt> makeUDSliceMoveTable();
+
+        static constexpr std::array<uint16_t, MoveFactory::NoMove + 1> makePhase2NextMoves();
+
+        // Neighbours of idx = a * bCnt + b in the product of two coordinates, see PruningTable.
+        template<typename TableA, typename TableB, typename Visit>
+        static void pairNeighbours(const TableA &tableA, const TableB &tableB, uint64_t bCnt, int moveCnt,
+                                   uint64_t idx, Visit &&visit);
+
+        // Index of a phase one position in FlipSliceTwistHeuristic_.
+        inline uint64_t phaseOneIndex(uint16_t twist, uint16_t flip, uint16_t slice) const;
+
+        template<typename Visit>
+        void flipSliceTwistNeighbours(uint64_t idx, Visit &&visit) const;
+
+        template<typename Visit>
+        void flipSliceTwistEquivalents(uint64_t idx, Visit &&visit) const;
+
+        template<typename Visit>
+        void conorPermSliceNeighbours(uint64_t idx, Visit &&visit) const;
+
+        template<typename Visit>
+        void edgePermSliceNeighbours(uint64_t idx, Visit &&visit) const;
+
+        // Depth first search for phase one solutions of exactly togo more moves. onSolution(path, length) is
+        // called for each of them, and the search stops once it returns true. depth is the exact distance
+        // to G1 of the current node.
+        //
+        // The searches below count their work into stats, see SearchStats.
+        template<typename OnSolution, typename Stats>
+        bool phaseOneDfs(uint16_t twist, uint16_t flip, uint16_t slice, uint32_t depth, int n, int togo,
+                         MoveName *path, OnSolution &onSolution, Stats &stats) const;
+
+        template<typename Stats>
+        bool phaseTwoDfs(uint16_t conorPerm, uint16_t edgePerm, uint8_t slicePerm, uint32_t conorDepth,
+                         uint32_t edgeDepth, int n, int togo, MoveName *path, Stats &stats) const;
+
+        // Node two moves below the phase one root, whose subtree solveParallel hands to one thread.
+        struct PhaseOnePrefix {
+            MoveName path_[2];
+            uint16_t twist_, flip_, slice_;
+            // Exact distances to G1 after the first and the second move.
+            uint32_t depth_[2];
+        };
+
+        // SearchStats which stop the searches once check(stats) returns true. The searches poll it every
+        // CheckInterval nodes, so a search overruns its budget by at most that many nodes.
+        template<typename Check>
+        struct BudgetedStats : SearchStats {
+            static constexpr bool Budgeted = true;
+            static constexpr uint32_t CheckInterval = 4096;
+
+            explicit BudgetedStats(Check check);
+
+            // Whether the budget is spent, calling check every CheckInterval calls. Stays true once spent.
+            bool spent();
+
+            // Call check now.
+            bool checkNow();
+
+        protected:
+            Check check_;
+            uint32_t sinceCheck_ = 0;
+            bool spent_ = false;
+        };
+
+        // The search of solveAnytime against best, the length of the shortest solution found by it or by any
+        // other search sharing best, with the nodes of all of them added up in nodes. Solutions shorter than
+        // best go to res. Returns the length of the last of them, or budget.maxLength_ + 1 if none.
+        int anytimeSearch(const CubeStatus &start, const SolveBudget &budget,
+                          std::chrono::steady_clock::time_point begin, std::atomic<int> &best,
+                          std::atomic<uint64_t> &nodes, SolveResult &res) const;
+
+        // Move entry, which holds the coordinates along an earlier path of the same search, to path.
+        inline void followPath(PhaseTwoEntry &entry, const MoveName *path, int length) const;
+
+        // Length of the shortest phase two solution after the phase one solution path written to
+        // phaseTwoPath, or -1 if it is longer than maxDepth or path ends with a G1 move. entry is moved to
+        // path, see followPath.
+        template<typename Stats>
+        int phaseTwoAfter(PhaseTwoEntry &entry, const MoveName *path, int length, int maxDepth,
+                          MoveName *phaseTwoPath, Stats &stats) const;
+
+        // Length of the shortest phase two solution written to path, or -1 if it is longer than maxDepth.
+        template<typename Stats>
+        int phaseTwoIda(uint16_t conorPerm, uint16_t edgePerm, uint8_t slicePerm, int maxDepth,
+                        MoveName *path, Stats &stats) const;
+
+        // IDA* over all phase one solutions of increasing length up to maxDepth, see phaseOneDfs.
+        template<typename OnSolution, typename Stats>
+        bool phaseOneIda(const CubeStatus &start, int maxDepth, MoveName *path, OnSolution &onSolution,
+                         Stats &stats) const;
+
+        // solve() and solveWithStats().
+        template<typename Stats>
+        bool solveWith(const CubeStatus &start, int maxLength, SearchContext &context, Stats &stats) const;
     };
 
     //**********************************************************************
     // Implementations
     //**********************************************************************
 
-    std::vector<BasicMoveName> TwoPhaseSolver::phaseOneSearch(const CubeStatus &start) {
-        return std::vector<BasicMoveName>();
+    std::vector<MoveName> TwoPhaseSolver::phaseOneSearch(const CubeStatus &start) const {
+        if (!replicas_.empty()) {
+            return local().phaseOneSearch(start);
+        }
+        MoveName path[MaxPhaseOneDepth];
+        int length = -1;
+        auto first = [&length](const MoveName *, int n) {
+            length = n;
+            return true;
+        };
+        NoSearchStats stats;
+        if (!phaseOneIda(start, MaxPhaseOneDepth, path, first, stats)) {
+            throw std::runtime_error(std::string(__func__) + ": phase one depth exceeded, invalid cube?");
+        }
+        return std::vector<MoveName>(path, path + length);
+    }
+
+    std::vector<MoveName> TwoPhaseSolver::phaseTwoSearch(const CubeStatus &start) const {
+        if (!replicas_.empty()) {
+            return local().phaseTwoSearch(start);
+        }
+        auto conorPerm = static_cast<uint16_t>(start.getConorPermCoord());
+        auto edgePerm = static_cast<uint16_t>(start.getPhase2EdgePermCoord());
+        auto slicePerm = static_cast<uint8_t>(start.getUDSliceSortedCoord() % SlicePermCnt);
+
+        MoveName path[MaxPhaseTwoDepth];
+        NoSearchStats stats;
+        int length = phaseTwoIda(conorPerm, edgePerm, slicePerm, MaxPhaseTwoDepth, path, stats);
+        if (length < 0) {
+            throw std::runtime_error(std::string(__func__) + ": phase two depth exceeded, cube not in G1?");
+        }
+        return std::vector<MoveName>(path, path + length);
+    }
+
+    std::vector<MoveName> TwoPhaseSolver::solve(const CubeStatus &start, int maxLength) const {
+        thread_local SearchContext context;
+        if (!solve(start, context, maxLength)) {
+            return {};
+        }
+        return std::vector<MoveName>(context.solution_, context.solution_ + context.length_);
+    }
+
+    bool TwoPhaseSolver::solve(const CubeStatus &start, SearchContext &context, int maxLength) const {
+        if (!replicas_.empty()) {
+            return local().solve(start, context, maxLength);
+        }
+        NoSearchStats stats;
+        return solveWith(start, maxLength, context, stats);
     }
 
-    std::vector<BasicMoveName> TwoPhaseSolver::phaseTwoSearch(const CubeStatus &start) {
-        return std::vector<BasicMoveName>();
+    TwoPhaseSolver::SolveResult TwoPhaseSolver::solveWithStats(const CubeStatus &start, int maxLength) const {
+        if (!replicas_.empty()) {
+            return local().solveWithStats(start, maxLength);
+        }
+        SolveResult res;
+        auto begin = std::chrono::steady_clock::now();
+        SearchContext context;
+        if (solveWith(start, maxLength, context, res.stats_)) {
+            res.solution_.assign(context.solution_, context.solution_ + context.length_);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        res.stats_.phaseOne_.seconds_ = elapsed.count() - res.stats_.phaseTwo_.seconds_;
+        return res;
     }
 
-    void TwoPhaseSolver::buildMoveTable() {
-        buildUdSliceMoveTable();
+    TwoPhaseSolver::SolveResult TwoPhaseSolver::solveAnytime(const CubeStatus &start, const SolveBudget &budget) const {
+        if (!replicas_.empty()) {
+            return local().solveAnytime(start, budget);
+        }
+        SolveResult res;
+        std::atomic<int> best{budget.maxLength_ + 1};
+        std::atomic<uint64_t> nodes{0};
+        anytimeSearch(start, budget, std::chrono::steady_clock::now(), best, nodes, res);
+        return res;
     }
 
-    void TwoPhaseSolver::buildUDSliceHeuristic() {
+    TwoPhaseSolver::SolveResult TwoPhaseSolver::solveRacing(const CubeStatus &start, ThreadPool &pool,
+                                                            const SolveBudget &budget) const {
+        auto begin = std::chrono::steady_clock::now();
+        std::atomic<int> best{budget.maxLength_ + 1};
+        std::atomic<uint64_t> nodes{0};
+        SolveResult results[RaceCnt];
+        int lengths[RaceCnt];
+        auto inverse = start.inverse();
+        // Sym_[16 * a] is S_URF3^a, which turns the F/B axis (a = 1) or the L/R axis (a = 2) into U/D.
+        pool.parallelFor(RaceCnt, 1, [&](uint64_t first, uint64_t last) {
+            for (uint64_t i = first; i < last; ++i) {
+                auto cube = MoveFactory::conjugate(i < 3 ? start : inverse, 16 * static_cast<int>(i % 3));
+                lengths[i] = local().anytimeSearch(cube, budget, begin, best, nodes, results[i]);
+            }
+        });
 
+        SolveResult res;
+        int winner = 0;
+        for (int i = 0; i < RaceCnt; ++i) {
+            res.stats_ += results[i].stats_;
+            winner = lengths[i] < lengths[winner] ? i : winner;
+        }
+        if (lengths[winner] > budget.maxLength_) {
+            return res;
+        }
+        // A solution b of S^-1 * c * S gives S * b * S^-1 for c, and one of c^-1 reversed and inverted.
+        const auto &solution = results[winner].solution_;
+        auto length = static_cast<int>(solution.size());
+        int s = 16 * (winner % 3);
+        for (int i = 0; i < length; ++i) {
+            int m = winner < 3 ? solution[i] : solution[length - 1 - i];
+            if (winner >= 3) {
+                m = m / 3 * 3 + 2 - m % 3;
+            }
+            res.solution_.push_back(MoveFactory::conjugateMove(static_cast<MoveName>(m), s));
+        }
+        return res;
     }
 
-    void TwoPhaseSolver::buildUdSliceMoveTable() {
+    template<typename Check>
+    TwoPhaseSolver::BudgetedStats<Check>::BudgetedStats(Check check) : check_(std::move(check)) {}
+
+    template<typename Check>
+    bool TwoPhaseSolver::BudgetedStats<Check>::spent() {
+        if (!spent_ && ++sinceCheck_ >= CheckInterval) {
+            return checkNow();
+        }
+        return spent_;
+    }
+
+    template<typename Check>
+    bool TwoPhaseSolver::BudgetedStats<Check>::checkNow() {
+        sinceCheck_ = 0;
+        spent_ = spent_ || check_(static_cast<const SearchStats &>(*this));
+        return spent_;
+    }
+
+    int TwoPhaseSolver::anytimeSearch(const CubeStatus &start, const SolveBudget &budget,
+                                      std::chrono::steady_clock::time_point begin, std::atomic<int> &best,
+                                      std::atomic<uint64_t> &nodes, SolveResult &res) const {
+        uint64_t counted = 0;
+        auto outOfBudget = [&](const SearchStats &cur) {
+            if (budget.nodes_ != 0) {
+                uint64_t total = cur.phaseOne_.totalNodes() + cur.phaseTwo_.totalNodes();
+                uint64_t all = nodes.fetch_add(total - counted, std::memory_order_relaxed) + total - counted;
+                counted = total;
+                if (all >= budget.nodes_) {
+                    return true;
+                }
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            return budget.seconds_ > 0 && elapsed.count() >= budget.seconds_;
+        };
+        BudgetedStats<decltype(outOfBudget)> stats(outOfBudget);
+
+        int found = budget.maxLength_ + 1;
+        PhaseTwoEntry entry;
+        entry.reset(start);
+        MoveName phaseTwoPath[MaxPhaseTwoDepth];
+        MoveName solution[MaxPhaseOneDepth + MaxPhaseTwoDepth];
+        auto tryPhaseTwo = [&](const MoveName *path, int length) {
+            // Phase one solutions come in order of length, so none of the rest is shorter.
+            int bound = best.load(std::memory_order_relaxed);
+            if (bound <= budget.targetLength_ || length >= bound || stats.checkNow()) {
+                return true;
+            }
+            int phaseTwoLength = phaseTwoAfter(entry, path, length, bound - 1 - length, phaseTwoPath, stats);
+            if (phaseTwoLength < 0) {
+                return false;
+            }
+            std::copy(path, path + length, solution);
+            std::copy(phaseTwoPath, phaseTwoPath + phaseTwoLength, solution + length);
+            int cur = MoveFactory::simplifyMoves(solution, length + phaseTwoLength);
+            // Another search may have found a solution as short meanwhile.
+            while (cur < bound && !best.compare_exchange_weak(bound, cur, std::memory_order_relaxed)) {}
+            if (cur < bound) {
+                found = cur;
+                res.solution_.assign(solution, solution + cur);
+            }
+            return cur <= budget.targetLength_;
+        };
+
+        auto searchBegin = std::chrono::steady_clock::now();
+        MoveName path[MaxPhaseOneDepth];
+        phaseOneIda(start, std::min(budget.maxLength_, MaxPhaseOneDepth), path, tryPhaseTwo, stats);
+        res.stats_ = stats;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - searchBegin;
+        res.stats_.phaseOne_.seconds_ = elapsed.count() - res.stats_.phaseTwo_.seconds_;
+        return found;
+    }
+
+    template<typename Stats>
+    bool TwoPhaseSolver::solveWith(const CubeStatus &start, int maxLength, SearchContext &context,
+                                   Stats &stats) const {
+        context.length_ = -1;
+        context.phaseTwoEntry_.reset(start);
+        auto tryPhaseTwo = [&](const MoveName *path, int length) {
+            int phaseTwoLength = phaseTwoAfter(context.phaseTwoEntry_, path, length, maxLength - length,
+                                               context.phaseTwoPath_, stats);
+            if (phaseTwoLength < 0) {
+                return false;
+            }
+            std::copy(path, path + length, context.solution_);
+            std::copy(context.phaseTwoPath_, context.phaseTwoPath_ + phaseTwoLength, context.solution_ + length);
+            // Turns of one face where the phases meet merge.
+            context.length_ = MoveFactory::simplifyMoves(context.solution_, length + phaseTwoLength);
+            return true;
+        };
+        return phaseOneIda(start, std::min(maxLength, MaxPhaseOneDepth), context.phaseOnePath_, tryPhaseTwo, stats);
+    }
+
+    std::vector<MoveName> TwoPhaseSolver::solveParallel(const CubeStatus &start, ThreadPool &pool,
+                                                        int maxLength) const {
+        // The threads of pool read the replica of the calling thread.
+        if (!replicas_.empty()) {
+            return local().solveParallel(start, pool, maxLength);
+        }
+        std::vector<MoveName> solution;
+        std::mutex solutionMutex;
+        // Length of the best solution so far, maxLength + 1 while there is none.
+        std::atomic<int> best{maxLength + 1};
+        NoSearchStats stats;
+        PhaseTwoEntry root;
+        root.reset(start);
+        auto tryPhaseTwo = [&](const MoveName *path, int length) {
+            int bound = best.load(std::memory_order_relaxed) - 1;
+            if (bound < maxLength) {
+                return true;
+            }
+            // Threads do not share an entry, and copying the root is cheaper than keeping one per thread.
+            PhaseTwoEntry entry = root;
+            MoveName phaseTwoPath[MaxPhaseTwoDepth];
+            int phaseTwoLength = phaseTwoAfter(entry, path, length, bound - length, phaseTwoPath, stats);
+            if (phaseTwoLength < 0) {
+                return false;
+            }
+            MoveName found[MaxPhaseOneDepth + MaxPhaseTwoDepth];
+            std::copy(path, path + length, found);
+            std::copy(phaseTwoPath, phaseTwoPath + phaseTwoLength, found + length);
+            int foundLength = MoveFactory::simplifyMoves(found, length + phaseTwoLength);
+            std::lock_guard<std::mutex> lock(solutionMutex);
+            if (foundLength < best.load(std::memory_order_relaxed)) {
+                best.store(foundLength, std::memory_order_relaxed);
+                solution.assign(found, found + foundLength);
+            }
+            return true;
+        };
+
+        auto twist = static_cast<uint16_t>(start.getConorOriCoord());
+        auto flip = static_cast<uint16_t>(start.getEdgeOriCoord());
+        auto slice = static_cast<uint16_t>(start.getUDSliceCoord());
+        uint32_t phaseOneDepth = FlipSliceTwistHeuristic_.distance(
+                phaseOneIndex(twist, flip, slice),
+                [this](uint64_t idx, auto &&visit) { flipSliceTwistNeighbours(idx, visit); });
+
+        std::vector<PhaseOnePrefix> prefixes;
+        for (int m0 = 0; m0 < MoveCnt; ++m0) {
+            PhaseOnePrefix first{};
+            first.twist_ = TwistMoveTable_[twist][m0];
+            first.flip_ = FlipMoveTable_[flip][m0];
+            first.slice_ = UDSliceMoveTable_[slice][m0];
+            uint64_t firstIdx = phaseOneIndex(first.twist_, first.flip_, first.slice_);
+            first.depth_[0] = PruningTable::nextDepth(phaseOneDepth, FlipSliceTwistHeuristic_.get(firstIdx));
+            for (uint32_t rest = MoveFactory::NextMoves_[m0]; rest != 0; rest &= rest - 1) {
+                int m1 = std::countr_zero(rest);
+                PhaseOnePrefix p{};
+                p.path_[0] = static_cast<MoveName>(m0);
+                p.path_[1] = static_cast<MoveName>(m1);
+                p.twist_ = TwistMoveTable_[first.twist_][m1];
+                p.flip_ = FlipMoveTable_[first.flip_][m1];
+                p.slice_ = UDSliceMoveTable_[first.slice_][m1];
+                p.depth_[0] = first.depth_[0];
+                p.depth_[1] = PruningTable::nextDepth(
+                        first.depth_[0], FlipSliceTwistHeuristic_.get(phaseOneIndex(p.twist_, p.flip_, p.slice_)));
+                prefixes.push_back(p);
+            }
+        }
+
+        int maxDepth = std::min(maxLength, MaxPhaseOneDepth);
+        for (int depth = static_cast<int>(phaseOneDepth); depth <= maxDepth; ++depth) {
+            if (depth < 2) {
+                MoveName path[MaxPhaseOneDepth];
+                phaseOneDfs(twist, flip, slice, phaseOneDepth, 0, depth, path, tryPhaseTwo, stats);
+            } else {
+                pool.parallelFor(prefixes.size(), 1, [&](uint64_t begin, uint64_t end) {
+                    for (uint64_t i = begin; i < end && best.load(std::memory_order_relaxed) > maxLength; ++i) {
+                        // The same pruning phaseOneDfs applies to the first two moves.
+                        const auto &p = prefixes[i];
+                        if (p.depth_[0] >= static_cast<uint32_t>(depth) ||
+                            p.depth_[1] >= static_cast<uint32_t>(depth - 1)) {
+                            continue;
+                        }
+                        MoveName path[MaxPhaseOneDepth] = {p.path_[0], p.path_[1]};
+                        phaseOneDfs(p.twist_, p.flip_, p.slice_, p.depth_[1], 2, depth - 2, path, tryPhaseTwo,
+                                    stats);
+                    }
+                });
+            }
+            if (best.load(std::memory_order_relaxed) <= maxLength) {
+                break;
+            }
+        }
+        return solution;
+    }
+
+    void TwoPhaseSolver::PhaseTwoEntry::reset(const CubeStatus &start) {
+        conorPerm_[0] = static_cast<uint16_t>(start.getConorPermCoord());
+        sliceSorted_[0] = static_cast<uint16_t>(start.getUDSliceSortedCoord());
+        uEdges_[0] = static_cast<uint16_t>(start.getUEdgesCoord());
+        dEdges_[0] = static_cast<uint16_t>(start.getDEdgesCoord());
+        valid_ = 0;
+    }
+
+    void TwoPhaseSolver::followPath(PhaseTwoEntry &entry, const MoveName *path, int length) const {
+        // Coordinates after the moves shared with the last path are still valid.
+        int n = 0;
+        while (n < std::min(entry.valid_, length) && entry.path_[n] == path[n]) {
+            ++n;
+        }
+        for (; n < length; ++n) {
+            int m = path[n];
+            entry.path_[n] = path[n];
+            entry.conorPerm_[n + 1] = ConorPermFullMoveTable_[entry.conorPerm_[n]][m];
+            entry.sliceSorted_[n + 1] = UDSliceSortedMoveTable_[entry.sliceSorted_[n]][m];
+            entry.uEdges_[n + 1] = UEdgesMoveTable_[entry.uEdges_[n]][m];
+            entry.dEdges_[n + 1] = DEdgesMoveTable_[entry.dEdges_[n]][m];
+        }
+        entry.valid_ = length;
+    }
+
+    template<typename Stats>
+    int TwoPhaseSolver::phaseTwoAfter(PhaseTwoEntry &entry, const MoveName *path, int length, int maxDepth,
+                                      MoveName *phaseTwoPath, Stats &stats) const {
+        // A phase one solution ending with a G1 move is a shorter one followed by a phase two move,
+        // which has already been tried.
+        if (length > 0 && std::find(Phase2Moves, Phase2Moves + Phase2MoveCnt, path[length - 1]) !=
+                          Phase2Moves + Phase2MoveCnt) {
+            return -1;
+        }
+        if (maxDepth < 0) {
+            return -1;
+        }
+        std::chrono::steady_clock::time_point begin;
+        if constexpr (Stats::Enabled) {
+            stats.phaseTwoSearches_ += 1;
+            begin = std::chrono::steady_clock::now();
+        }
+        followPath(entry, path, length);
+        // In G1 the slice edges are in the slice, so the sorted coordinate is the slice permutation.
+        int phaseTwoLength = phaseTwoIda(entry.conorPerm_[length],
+                                         Phase2EdgeMerge_[entry.uEdges_[length]][entry.dEdges_[length] % SlicePermCnt],
+                                         static_cast<uint8_t>(entry.sliceSorted_[length]),
+                                         std::min(maxDepth, MaxPhaseTwoDepth), phaseTwoPath, stats);
+        if constexpr (Stats::Enabled) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            stats.phaseTwo_.seconds_ += elapsed.count();
+        }
+        return phaseTwoLength;
+    }
+
+    std::vector<std::vector<MoveName>> TwoPhaseSolver::solveBatch(std::span<const CubeStatus> cubes, ThreadPool &pool,
+                                                                  int maxLength) const {
+        std::vector<std::vector<MoveName>> solutions(cubes.size());
+        // One cube per chunk: solve times vary by orders of magnitude, so balancing by count is useless.
+        pool.parallelFor(cubes.size(), 1, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                solutions[i] = solve(cubes[i], maxLength);
+            }
+        });
+        return solutions;
+    }
+
+    template<typename OnSolution, typename Stats>
+    bool TwoPhaseSolver::phaseOneIda(const CubeStatus &start, int maxDepth, MoveName *path,
+                                     OnSolution &onSolution, Stats &stats) const {
+        auto twist = static_cast<uint16_t>(start.getConorOriCoord());
+        auto flip = static_cast<uint16_t>(start.getEdgeOriCoord());
+        auto slice = static_cast<uint16_t>(start.getUDSliceCoord());
+        uint32_t phaseOneDepth = FlipSliceTwistHeuristic_.distance(
+                phaseOneIndex(twist, flip, slice),
+                [this](uint64_t idx, auto &&visit) { flipSliceTwistNeighbours(idx, visit); });
+
+        for (int depth = static_cast<int>(phaseOneDepth); depth <= maxDepth; ++depth) {
+            if (phaseOneDfs(twist, flip, slice, phaseOneDepth, 0, depth, path, onSolution, stats)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename OnSolution, typename Stats>
+    bool TwoPhaseSolver::phaseOneDfs(uint16_t twist, uint16_t flip, uint16_t slice, uint32_t depth, int n, int togo,
+                                     MoveName *path, OnSolution &onSolution, Stats &stats) const {
+        if constexpr (Stats::Enabled) {
+            stats.phaseOne_.nodes_[n] += 1;
+        }
+        // Stopping unwinds like a solution, the caller tells them apart by the budget.
+        if constexpr (Stats::Budgeted) {
+            if (stats.spent()) {
+                return true;
+            }
+        }
+        if (togo == 0) {
+            if (twist != 0 || flip != 0 || slice != 0) {
+                return false;
+            }
+            if constexpr (Stats::Enabled) {
+                stats.phaseOneSolutions_ += 1;
+            }
+            return onSolution(path, n);
+        }
+        // All children first, so that the cache misses of their heuristic entries overlap.
+        uint32_t allowed = MoveFactory::NextMoves_[n > 0 ? path[n - 1] : MoveFactory::NoMove];
+        uint16_t nextTwist[MoveCnt], nextFlip[MoveCnt], nextSlice[MoveCnt];
+        uint64_t nextIdx[MoveCnt];
+        for (uint32_t rest = allowed; rest != 0; rest &= rest - 1) {
+            int m = std::countr_zero(rest);
+            nextTwist[m] = TwistMoveTable_[twist][m];
+            nextFlip[m] = FlipMoveTable_[flip][m];
+            nextSlice[m] = UDSliceMoveTable_[slice][m];
+            nextIdx[m] = phaseOneIndex(nextTwist[m], nextFlip[m], nextSlice[m]);
+            FlipSliceTwistHeuristic_.prefetch(nextIdx[m]);
+        }
+
+        for (uint32_t rest = allowed; rest != 0; rest &= rest - 1) {
+            int m = std::countr_zero(rest);
+            uint32_t nextDepth = PruningTable::nextDepth(depth, FlipSliceTwistHeuristic_.get(nextIdx[m]));
+            if constexpr (Stats::Enabled) {
+                stats.phaseOne_.children_ += 1;
+                stats.phaseOne_.cutoffs_ += nextDepth >= static_cast<uint32_t>(togo);
+            }
+            if (nextDepth >= static_cast<uint32_t>(togo)) {
+                continue;
+            }
+            path[n] = static_cast<MoveName>(m);
+            if (phaseOneDfs(nextTwist[m], nextFlip[m], nextSlice[m], nextDepth, n + 1, togo - 1, path, onSolution,
+                            stats)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Stats>
+    int TwoPhaseSolver::phaseTwoIda(uint16_t conorPerm, uint16_t edgePerm, uint8_t slicePerm, int maxDepth,
+                                    MoveName *path, Stats &stats) const {
+        uint32_t conorDepth = ConorPermSliceHeuristic_.distance(
+                conorPerm * SlicePermCnt + slicePerm,
+                [this](uint64_t idx, auto &&visit) { conorPermSliceNeighbours(idx, visit); });
+        uint32_t edgeDepth = EdgePermSliceHeuristic_.distance(
+                edgePerm * SlicePermCnt + slicePerm,
+                [this](uint64_t idx, auto &&visit) { edgePermSliceNeighbours(idx, visit); });
+
+        for (int depth = std::max(conorDepth, edgeDepth); depth <= maxDepth; ++depth) {
+            if (phaseTwoDfs(conorPerm, edgePerm, slicePerm, conorDepth, edgeDepth, 0, depth, path, stats)) {
+                return depth;
+            }
+            if constexpr (Stats::Budgeted) {
+                if (stats.spent()) {
+                    return -1;
+                }
+            }
+        }
+        return -1;
+    }
+
+    template<typename Stats>
+    bool TwoPhaseSolver::phaseTwoDfs(uint16_t conorPerm, uint16_t edgePerm, uint8_t slicePerm, uint32_t conorDepth,
+                                     uint32_t edgeDepth, int n, int togo, MoveName *path, Stats &stats) const {
+        if constexpr (Stats::Enabled) {
+            stats.phaseTwo_.nodes_[n] += 1;
+        }
+        if constexpr (Stats::Budgeted) {
+            if (stats.spent()) {
+                return false;
+            }
+        }
+        if (togo == 0) {
+            return conorPerm == 0 && edgePerm == 0 && slicePerm == 0;
+        }
+        for (uint32_t rest = Phase2NextMoves_[n > 0 ? path[n - 1] : MoveFactory::NoMove]; rest != 0;
+             rest &= rest - 1) {
+            int k = std::countr_zero(rest);
+            uint16_t nextConorPerm = ConorPermMoveTable_[conorPerm][k];
+            uint16_t nextEdgePerm = Phase2EdgePermMoveTable_[edgePerm][k];
+            uint8_t nextSlicePerm = SlicePermMoveTable_[slicePerm][k];
+            uint32_t nextConorDepth = PruningTable::nextDepth(
+                    conorDepth, ConorPermSliceHeuristic_.get(nextConorPerm * SlicePermCnt + nextSlicePerm));
+            if constexpr (Stats::Enabled) {
+                stats.phaseTwo_.children_ += 1;
+                stats.phaseTwo_.cutoffs_ += nextConorDepth >= static_cast<uint32_t>(togo);
+            }
+            if (nextConorDepth >= static_cast<uint32_t>(togo)) {
+                continue;
+            }
+            uint32_t nextEdgeDepth = PruningTable::nextDepth(
+                    edgeDepth, EdgePermSliceHeuristic_.get(nextEdgePerm * SlicePermCnt + nextSlicePerm));
+            if constexpr (Stats::Enabled) {
+                stats.phaseTwo_.cutoffs_ += nextEdgeDepth >= static_cast<uint32_t>(togo);
+            }
+            if (nextEdgeDepth >= static_cast<uint32_t>(togo)) {
+                continue;
+            }
+            path[n] = Phase2Moves[k];
+            if (phaseTwoDfs(nextConorPerm, nextEdgePerm, nextSlicePerm, nextConorDepth, nextEdgeDepth, n + 1,
+                            togo - 1, path, stats)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Visit>
+    void TwoPhaseSolver::forEachTable(Visit visit) {
+        visit(TwistMoveTable_, TwistCnt);
+        visit(FlipMoveTable_, FlipCnt);
+        visit(ConorPermMoveTable_, ConorPermCnt);
+        visit(Phase2EdgePermMoveTable_, Phase2EdgePermCnt);
+        visit(ConorPermFullMoveTable_, ConorPermCnt);
+        visit(UDSliceSortedMoveTable_, UDEdgesCnt);
+        visit(UEdgesMoveTable_, UDEdgesCnt);
+        visit(DEdgesMoveTable_, UDEdgesCnt);
+        visit(Phase2EdgeMerge_, Phase2UDEdgesCnt);
+        visit(FlipSliceClassIdx_, FlipSliceCnt);
+        visit(FlipSliceSym_, FlipSliceCnt);
+        visit(FlipSliceRep_, FlipSliceClassCnt);
+        visit(FlipSliceSelfSym_, FlipSliceClassCnt);
+        visit(TwistConj_, TwistCnt);
+        visit(FlipSliceTwistHeuristic_, static_cast<uint64_t>(FlipSliceClassCnt) * TwistCnt);
+        visit(ConorPermSliceHeuristic_, ConorPermCnt * SlicePermCnt);
+        visit(EdgePermSliceHeuristic_, Phase2EdgePermCnt * SlicePermCnt);
+    }
+
+    std::vector<uint64_t> TwoPhaseSolver::tableLayout() {
+        std::vector<uint64_t> sectionSize;
+        forEachTable([&sectionSize](auto &table, uint64_t cnt) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(table)>, PruningTable>) {
+                sectionSize.push_back(PruningTable::byteSize(cnt));
+            } else {
+                sectionSize.push_back(cnt * sizeof(*table));
+            }
+        });
+        return sectionSize;
+    }
+
+    void TwoPhaseSolver::bindTables() {
+        uint32_t i = 0;
+        forEachTable([this, &i](auto &table, uint64_t cnt) {
+            using Table = std::decay_t<decltype(table)>;
+            if constexpr (std::is_same_v<Table, PruningTable>) {
+                table = PruningTable(reinterpret_cast<uint64_t *>(tables_.section(i)), cnt);
+            } else {
+                table = reinterpret_cast<Table>(tables_.section(i));
+            }
+            i += 1;
+        });
+    }
+
+    void TwoPhaseSolver::buildTables() {
+        ThreadPool pool;
+        buildMoveTable(pool);
+        buildSymTable(pool);
+        buildHeuristic(pool);
+    }
+
+    void TwoPhaseSolver::buildMoveTable(ThreadPool &pool) {
+        buildTwistMoveTable(pool);
+        buildFlipMoveTable(pool);
+        buildConorPermMoveTable(pool);
+        buildPhase2EdgePermMoveTable(pool);
+        buildPhaseTwoEntryTables(pool);
+    }
+
+    template<typename MoveTable, size_t N, typename GetBy, typename GetCoords>
+    void TwoPhaseSolver::buildCoordMoveTable(ThreadPool &pool, MoveTable &table, int cnt,
+                                             const MoveName (&moves)[N], GetBy getBy, GetCoords getCoords) {
+        pool.parallelFor(cnt, 256, [&](uint64_t begin, uint64_t end) {
+            CubeStatus next[N];
+            for (uint64_t i = begin; i < end; ++i) {
+                auto cur = getBy(i);
+                for (size_t k = 0; k < N; ++k) {
+                    next[k] = moveFactory.getMoveByName(moves[k]) * cur;
+                }
+                getCoords(std::span<const CubeStatus>(next, N), table[i]);
+            }
+        });
+    }
+
+    template<typename Entry, size_t Cnt, size_t N, typename GetBy, typename GetCoord>
+    constexpr std::array<std::array<Entry, N>, Cnt>
+    TwoPhaseSolver::makeCoordMoveTable(const MoveName (&moves)[N], GetBy getBy, GetCoord getCoord) {
+        std::array<std::array<Entry, N>, Cnt> table{};
+        for (size_t i = 0; i < Cnt; ++i) {
+            auto cur = getBy(i);
+            for (size_t k = 0; k < N; ++k) {
+                table[i][k] = static_cast<Entry>(getCoord(MoveFactory::getMoveByName(moves[k]) * cur));
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<std::array<uint16_t, TwoPhaseSolver::MoveCnt>, TwoPhaseSolver::UDSliceCnt>
+    TwoPhaseSolver::makeUDSliceMoveTable() {
+        constexpr int EdgeCnt = 12;
+        // Bit j of a mask is set if a slice edge is at edge position j.
+        uint16_t maskOf[UDSliceCnt] = {};
+        uint16_t coordOf[1 << EdgeCnt] = {};
         for (int i = 0; i < UDSliceCnt; ++i) {
-            auto cur = moveFactory.getByUDSliceCoord(i);
-            for (int face = 0; face <= BasicMoveName::R; ++face) {
-                auto m = moveFactory.getMoveByEnum(static_cast<BasicMoveName>(face));
-                for (int j = 0; j < 4; ++j) {
-                    cur = m * cur;
-                    if (j < 3) {
-                        uint64_t co = cur.getUDSliceCoord();
-                        UDSliceMoveTable_[i][3 * face + j] = co;
+            auto c = MoveFactory::getByUDSliceCoord(i);
+            for (int j = 0; j < EdgeCnt; ++j) {
+                if (c.move_[j + BlockPos::UR].pos() >= BlockPos::FR) {
+                    maskOf[i] |= static_cast<uint16_t>(1 << j);
+                }
+            }
+            coordOf[maskOf[i]] = static_cast<uint16_t>(i);
+        }
+        std::array<std::array<uint16_t, MoveCnt>, UDSliceCnt> table{};
+        for (int m = 0; m < MoveCnt; ++m) {
+            int from[EdgeCnt] = {};
+            for (int j = 0; j < EdgeCnt; ++j) {
+                from[j] = MoveFactory::getMoveByName(Phase1Moves[m]).move_[j + BlockPos::UR].pos() - BlockPos::UR;
+            }
+            for (int i = 0; i < UDSliceCnt; ++i) {
+                int mask = 0;
+                for (int j = 0; j < EdgeCnt; ++j) {
+                    mask |= (maskOf[i] >> from[j] & 1) << j;
+                }
+                table[i][m] = coordOf[mask];
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<uint16_t, MoveFactory::NoMove + 1> TwoPhaseSolver::makePhase2NextMoves() {
+        std::array<uint16_t, MoveFactory::NoMove + 1> next{};
+        for (int last = 0; last <= MoveFactory::NoMove; ++last) {
+            for (int k = 0; k < Phase2MoveCnt; ++k) {
+                if ((MoveFactory::NextMoves_[last] >> Phase2Moves[k] & 1) != 0) {
+                    next[last] |= static_cast<uint16_t>(1 << k);
+                }
+            }
+        }
+        return next;
+    }
+
+    template<typename TableA, typename TableB, typename Visit>
+    void TwoPhaseSolver::pairNeighbours(const TableA &tableA, const TableB &tableB, uint64_t bCnt, int moveCnt,
+                                        uint64_t idx, Visit &&visit) {
+        uint64_t a = idx / bCnt, b = idx % bCnt;
+        for (int m = 0; m < moveCnt; ++m) {
+            if (visit(tableA[a][m] * bCnt + tableB[b][m])) {
+                return;
+            }
+        }
+    }
+
+    uint64_t TwoPhaseSolver::phaseOneIndex(uint16_t twist, uint16_t flip, uint16_t slice) const {
+        uint32_t flipSlice = slice * FlipCnt + flip;
+        return static_cast<uint64_t>(FlipSliceClassIdx_[flipSlice]) * TwistCnt +
+               TwistConj_[twist][FlipSliceSym_[flipSlice]];
+    }
+
+    template<typename Visit>
+    void TwoPhaseSolver::flipSliceTwistNeighbours(uint64_t idx, Visit &&visit) const {
+        uint32_t rep = FlipSliceRep_[idx / TwistCnt];
+        auto twist = static_cast<uint16_t>(idx % TwistCnt);
+        auto flip = static_cast<uint16_t>(rep % FlipCnt), slice = static_cast<uint16_t>(rep / FlipCnt);
+        for (int m = 0; m < MoveCnt; ++m) {
+            if (visit(phaseOneIndex(TwistMoveTable_[twist][m], FlipMoveTable_[flip][m],
+                                    UDSliceMoveTable_[slice][m]))) {
+                return;
+            }
+        }
+    }
+
+    template<typename Visit>
+    void TwoPhaseSolver::flipSliceTwistEquivalents(uint64_t idx, Visit &&visit) const {
+        uint64_t classIdx = idx / TwistCnt;
+        auto twist = static_cast<uint16_t>(idx % TwistCnt);
+        // The representative conjugated by one of its own symmetries is itself, only the twist changes.
+        for (int s = 1, selfSym = FlipSliceSelfSym_[classIdx] >> 1; selfSym != 0; ++s, selfSym >>= 1) {
+            if ((selfSym & 1) != 0 && visit(classIdx * TwistCnt + TwistConj_[twist][s])) {
+                return;
+            }
+        }
+    }
+
+    template<typename Visit>
+    void TwoPhaseSolver::conorPermSliceNeighbours(uint64_t idx, Visit &&visit) const {
+        pairNeighbours(ConorPermMoveTable_, SlicePermMoveTable_, SlicePermCnt, Phase2MoveCnt, idx, visit);
+    }
+
+    template<typename Visit>
+    void TwoPhaseSolver::edgePermSliceNeighbours(uint64_t idx, Visit &&visit) const {
+        pairNeighbours(Phase2EdgePermMoveTable_, SlicePermMoveTable_, SlicePermCnt, Phase2MoveCnt, idx, visit);
+    }
+
+    void TwoPhaseSolver::buildTwistMoveTable(ThreadPool &pool) {
+        buildCoordMoveTable(pool, TwistMoveTable_, TwistCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByConorOriCoord(co); },
+                            CoordBatch::conorOri);
+    }
+
+    void TwoPhaseSolver::buildFlipMoveTable(ThreadPool &pool) {
+        buildCoordMoveTable(pool, FlipMoveTable_, FlipCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByEdgeOriCoord(co); },
+                            CoordBatch::edgeOri);
+    }
+
+    void TwoPhaseSolver::buildConorPermMoveTable(ThreadPool &pool) {
+        buildCoordMoveTable(pool, ConorPermMoveTable_, ConorPermCnt, Phase2Moves,
+                            [this](uint64_t co) { return moveFactory.getByConorPermCoord(co); },
+                            CoordBatch::conorPerm);
+    }
+
+    void TwoPhaseSolver::buildPhase2EdgePermMoveTable(ThreadPool &pool) {
+        buildCoordMoveTable(pool, Phase2EdgePermMoveTable_, Phase2EdgePermCnt, Phase2Moves,
+                            [this](uint64_t co) { return moveFactory.getByPhase2EdgePermCoord(co); },
+                            CoordBatch::phase2EdgePerm);
+    }
+
+    void TwoPhaseSolver::buildPhaseTwoEntryTables(ThreadPool &pool) {
+        buildCoordMoveTable(pool, ConorPermFullMoveTable_, ConorPermCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByConorPermCoord(co); },
+                            CoordBatch::conorPerm);
+        buildCoordMoveTable(pool, UDSliceSortedMoveTable_, UDEdgesCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByUDSliceSortedCoord(co); },
+                            CoordBatch::udSliceSorted);
+        buildCoordMoveTable(pool, UEdgesMoveTable_, UDEdgesCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByUEdgesCoord(co); },
+                            CoordBatch::uEdges);
+        buildCoordMoveTable(pool, DEdgesMoveTable_, UDEdgesCnt, Phase1Moves,
+                            [this](uint64_t co) { return moveFactory.getByDEdgesCoord(co); },
+                            CoordBatch::dEdges);
+
+        // The D edges fill the positions of the U and D layers left by the U edges, in the order given by
+        // the permutation part of their coordinate.
+        for (uint32_t u = 0; u < Phase2UDEdgesCnt; ++u) {
+            auto cube = moveFactory.getByUEdgesCoord(u);
+            uint64_t dComb = 0;
+            for (int i = 0, j = 0; i < 8; ++i) {
+                if (cube.move_[BlockPos::UR + i].pos() >= BlockPos::DR) {
+                    dComb += static_cast<uint64_t>(ConstantFactory::getBiCoef(i, ++j));
+                }
+            }
+            for (uint32_t d = 0; d < SlicePermCnt; ++d) {
+                auto dEdges = moveFactory.getByDEdgesCoord(d + 24 * dComb);
+                for (int i = BlockPos::UR; i <= BlockPos::DB; ++i) {
+                    if (cube.move_[i].pos() >= BlockPos::DR) {
+                        cube.move_[i] = dEdges.move_[i];
                     }
                 }
+                Phase2EdgeMerge_[u][d] = static_cast<uint16_t>(cube.getPhase2EdgePermCoord());
+            }
+        }
+    }
+
+    void TwoPhaseSolver::buildSymTable(ThreadPool &pool) {
+        buildFlipSliceSymTable();
+        buildTwistConjTable(pool);
+    }
+
+    void TwoPhaseSolver::buildFlipSliceSymTable() {
+        // Classes are numbered in the order of their smallest member, which needs a sequential scan. Only
+        // the representatives are conjugated, a small fraction of the build.
+        constexpr uint16_t invalid = std::numeric_limits<uint16_t>::max();
+        auto getByFlipSlice = [this](uint32_t flipSlice) {
+            auto res = moveFactory.getByUDSliceCoord(flipSlice / FlipCnt);
+            auto ori = moveFactory.getByEdgeOriCoord(flipSlice % FlipCnt);
+            for (int i = BlockPos::UR; i <= BlockPos::BR; ++i) {
+                res.move_[i].setOri(ori.move_[i].ori());
+            }
+            return res;
+        };
+
+        std::fill(FlipSliceClassIdx_, FlipSliceClassIdx_ + FlipSliceCnt, invalid);
+        std::fill(FlipSliceSym_, FlipSliceSym_ + FlipSliceCnt, 0);
+        uint16_t classIdx = 0;
+        for (uint32_t flipSlice = 0; flipSlice < FlipSliceCnt; ++flipSlice) {
+            if (FlipSliceClassIdx_[flipSlice] != invalid) {
+                continue;
+            }
+            if (classIdx == FlipSliceClassCnt) {
+                throw std::runtime_error(std::string(__func__) + ": more flipslice classes than expected");
+            }
+            auto rep = getByFlipSlice(flipSlice);
+            uint16_t selfSym = 0;
+            for (int s = 0; s < SymCnt; ++s) {
+                // Conjugating by the inverse, so that conjugating by s leads back to the representative.
+                auto c = moveFactory.conjugate(rep, moveFactory.SymInv_[s]);
+                uint32_t other = c.getUDSliceCoord() * FlipCnt + c.getEdgeOriCoord();
+                if (other == flipSlice) {
+                    selfSym |= 1 << s;
+                }
+                if (FlipSliceClassIdx_[other] == invalid) {
+                    FlipSliceClassIdx_[other] = classIdx;
+                    FlipSliceSym_[other] = s;
+                }
             }
+            FlipSliceRep_[classIdx] = flipSlice;
+            FlipSliceSelfSym_[classIdx] = selfSym;
+            classIdx += 1;
         }
     }
 
-    void TwoPhaseSolver::buildHeuristic() {
-        buildUDSliceHeuristic();
+    void TwoPhaseSolver::buildTwistConjTable(ThreadPool &pool) {
+        pool.parallelFor(TwistCnt, 64, [this](uint64_t begin, uint64_t end) {
+            for (uint64_t twist = begin; twist < end; ++twist) {
+                auto c = moveFactory.getByConorOriCoord(twist);
+                for (int s = 0; s < SymCnt; ++s) {
+                    TwistConj_[twist][s] = static_cast<uint16_t>(moveFactory.conjugate(c, s).getConorOriCoord());
+                }
+            }
+        });
+    }
+
+    void TwoPhaseSolver::buildFlipSliceTwistHeuristic(ThreadPool &pool) {
+        FlipSliceTwistHeuristic_.build(
+                pool, [this](uint64_t idx, auto &&visit) { flipSliceTwistNeighbours(idx, visit); },
+                [this](uint64_t idx, auto &&visit) { flipSliceTwistEquivalents(idx, visit); });
+    }
+
+    void TwoPhaseSolver::buildConorPermSliceHeuristic(ThreadPool &pool) {
+        ConorPermSliceHeuristic_.build(
+                pool, [this](uint64_t idx, auto &&visit) { conorPermSliceNeighbours(idx, visit); });
+    }
+
+    void TwoPhaseSolver::buildEdgePermSliceHeuristic(ThreadPool &pool) {
+        EdgePermSliceHeuristic_.build(
+                pool, [this](uint64_t idx, auto &&visit) { edgePermSliceNeighbours(idx, visit); });
+    }
+
+    void TwoPhaseSolver::buildHeuristic(ThreadPool &pool) {
+        buildFlipSliceTwistHeuristic(pool);
+        buildConorPermSliceHeuristic(pool);
+        buildEdgePermSliceHeuristic(pool);
     }
 
     TwoPhaseSolver::TwoPhaseSolver() {
-        buildMoveTable();
-        buildHeuristic();
+        tables_ = TableStorage::allocate(tableLayout());
+        bindTables();
+        buildTables();
     }
+
+    TwoPhaseSolver::TwoPhaseSolver(const std::string &tablePath) {
+        auto layout = tableLayout();
+        tables_ = TableStorage::map(tablePath, layout);
+        if (!tables_.empty()) {
+            bindTables();
+            return;
+        }
+        tables_ = TableStorage::allocate(layout);
+        bindTables();
+        buildTables();
+        // Failing to write the file only costs the next process a rebuild.
+        tables_.save(tablePath);
+    }
+
+    TwoPhaseSolver::TwoPhaseSolver(const TwoPhaseSolver &other, int node) : tables_(other.tables_.copy(node)) {
+        bindTables();
+    }
+
+    bool TwoPhaseSolver::tablesMapped() const {
+        return tables_.mapped();
+    }
+
+    void TwoPhaseSolver::placeTables(NumaPolicy policy) {
+        replicas_.clear();
+        if (policy == NumaPolicy::Interleave) {
+            tables_ = tables_.copy(NumaTopology::AllNodes);
+            bindTables();
+        } else if (policy == NumaPolicy::Replicate) {
+            for (int node = 0; node < NumaTopology::get().nodeCnt(); ++node) {
+                std::unique_ptr<TwoPhaseSolver> replica(new TwoPhaseSolver(*this, node));
+                replicas_.push_back(std::move(replica));
+            }
+        }
+    }
+
+    const TwoPhaseSolver &TwoPhaseSolver::local() const {
+        if (replicas_.empty()) {
+            return *this;
+        }
+        return *replicas_[NumaTopology::get().currentNode()];
+    }
+
+    inline constexpr std::array<std::array<uint16_t, TwoPhaseSolver::MoveCnt>, TwoPhaseSolver::UDSliceCnt>
+            TwoPhaseSolver::UDSliceMoveTable_ = makeUDSliceMoveTable();
+
+    inline constexpr std::array<uint16_t, MoveFactory::NoMove + 1> TwoPhaseSolver::Phase2NextMoves_ =
+            makePhase2NextMoves();
+
+    // In G1 the UD-slice coordinate is 0, so the sorted coordinate is just the permutation of the slice.
+    inline constexpr std::array<std::array<uint8_t, TwoPhaseSolver::Phase2MoveCnt>, TwoPhaseSolver::SlicePermCnt>
+            TwoPhaseSolver::SlicePermMoveTable_ = makeCoordMoveTable<uint8_t, SlicePermCnt>(
+            Phase2Moves, MoveFactory::getByUDSliceSortedCoord,
+            [](const CubeStatus &c) { return c.getUDSliceSortedCoord(); });
 }
 
 #endif //CUBE_SOLVER_TWO_PHASE_SOLVER_H
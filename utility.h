@@ -10,6 +10,11 @@ namespace Cube {
         U, D, F, B, L, R
     };
 
+    // All 18 face turns. Index is 3 * face + (quarter turns - 1), face ordered as in BasicMoveName.
+    enum MoveName {
+        U1, U2, U3, D1, D2, D3, F1, F2, F3, B1, B2, B3, L1, L2, L3, R1, R2, R3
+    };
+
     enum Color {
         Green, Yellow, Red, Blue, Orange, White
     };
@@ -18,6 +23,29 @@ namespace Cube {
         URF = 0, UFL, ULB, UBR, DFR, DLF, DBL, DRB, UR, UF, UL, UB, DR, DF, DL, DB, FR, FL, BL, BR
     };
 
+    // Factorials and binomial coefficients, computed at compile time.
+    struct ConstantTables {
+        static constexpr unsigned IDX_BOUND = 18;
+
+        int64_t binomial_[IDX_BOUND][IDX_BOUND] = {};
+        int64_t factorial_[IDX_BOUND] = {};
+
+        constexpr ConstantTables() {
+            factorial_[0] = 1;
+            for (unsigned i = 1; i < IDX_BOUND; ++i) {
+                factorial_[i] = factorial_[i - 1] * i;
+            }
+
+            for (unsigned n = 0; n < IDX_BOUND; ++n) {
+                for (unsigned k = 0; k <= n; ++k) {
+                    binomial_[n][k] = factorial_[n] / (factorial_[k] * factorial_[n - k]);
+                }
+            }
+        }
+    };
+
+    inline constexpr ConstantTables Constants{};
+
     class ConstantFactory {
     public:
         static ConstantFactory &getInstance() {
@@ -25,63 +53,45 @@ namespace Cube {
             return INSTANCE;
         }
 
-        static constexpr unsigned IDX_BOUND = 18;
+        static constexpr unsigned IDX_BOUND = ConstantTables::IDX_BOUND;
 
         // Prevent instantiation
         ConstantFactory(const ConstantFactory &) = delete;
 
         void operator=(const ConstantFactory &) = delete;
 
-        int64_t getFactorial(int k) const {
-            return factorial_[k];
+        static constexpr int64_t getFactorial(int k) {
+            return Constants.factorial_[k];
         }
 
-        int64_t getBiCoef(int n, int k) {
-            return binomial_[n][k];
+        static constexpr int64_t getBiCoef(int n, int k) {
+            return Constants.binomial_[n][k];
         }
 
     protected:
-        // Member variables
-
-        int64_t binomial_[IDX_BOUND][IDX_BOUND];
-        int64_t factorial_[IDX_BOUND];
-
         // Private constructor
-        ConstantFactory() {
-            factorial_[0] = 1;
-            for (int i = 1; i < IDX_BOUND; ++i) {
-                factorial_[i] = factorial_[i - 1] * i;
-            }
-
-            for (int n = 0; n < IDX_BOUND; ++n) {
-                for (int k = 0; k <= n; ++k) {
-                    binomial_[n][k] = factorial_[n] / (factorial_[k] * factorial_[n - k]);
-                }
-                for (int k = n + 1; k < IDX_BOUND; ++k) {
-                    binomial_[n][k] = 0;
-                }
-            }
-        }
+        ConstantFactory() = default;
     };
 
+    // Random engines, one per thread, so that threads drawing cubes neither contend nor share a sequence.
     class RandomFactory {
     public:
-        static inline RandomFactory &getInstance() {
-            static RandomFactory INSTANCE;
-            return INSTANCE;
-        }
+        using Engine = std::mt19937_64;
 
-        RandomFactory(const RandomFactory &) = delete;
-
-        void operator=(const RandomFactory &) = delete;
-
-        std::mt19937 generator_;
-    protected:
-        std::random_device device_{};
+        RandomFactory() = delete;
 
+        // Engine of the calling thread, seeded from std::random_device on first use.
+        static Engine &generator() {
+            thread_local Engine engine = [] {
+                std::random_device device;
+                return Engine(static_cast<uint64_t>(device()) << 32 | device());
+            }();
+            return engine;
+        }
 
-        RandomFactory() {
-            generator_ = std::mt19937(device_());
+        // Reseed the engine of the calling thread, for reproducible sequences.
+        static void seed(uint64_t seed) {
+            generator().seed(seed);
         }
     };
 }